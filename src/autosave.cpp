@@ -0,0 +1,105 @@
+#include "autosave.hpp"
+#include "world_save.hpp"
+#include "profiler.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <print>
+#include <utility>
+
+namespace sand {
+
+autosaver::autosaver()
+    : d_thread{[this](std::stop_token token) { run(token); }}
+{}
+
+autosaver::~autosaver()
+{
+    d_thread.request_stop();
+}
+
+auto autosaver::save(world& w, const std::string& file_path) -> void
+{
+    const auto zone = profile_zone{"autosaver::save"};
+    auto j = job{
+        .file_path = file_path,
+        .width = w.pixels.width(),
+        .height = w.pixels.height(),
+        .spawn_point = w.spawn_point
+    };
+
+    for (auto index = w.unsaved.find_last(w.chunks.size()); index != chunk_bitset::npos; index = w.unsaved.find_last(index)) {
+        auto& copy = j.chunks.emplace_back(chunk_copy{.index = index, .boards = w.pixels.bitboards(index)});
+        if (w.pixels.is_paged_out(index)) {
+            copy.block = w.pixels.encode_chunk(index);
+        } else {
+            copy.page = std::make_unique<chunk_page>(w.pixels.page(index));
+        }
+    }
+    w.unsaved.clear();
+
+    {
+        const auto lock = std::scoped_lock{d_mutex};
+        d_jobs.push_back(std::move(j));
+        ++d_pending;
+    }
+    d_job_ready.notify_one();
+}
+
+auto autosaver::is_busy() -> bool
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    return d_pending > 0;
+}
+
+auto autosaver::run(std::stop_token token) -> void
+{
+    while (true) {
+        auto jobs = std::vector<job>{};
+        {
+            auto lock = std::unique_lock{d_mutex};
+            // False only once stopped with nothing left to write
+            if (!d_job_ready.wait(lock, token, [&] { return !d_jobs.empty(); })) return;
+            jobs.swap(d_jobs);
+        }
+        for (auto& j : jobs) {
+            write(j);
+            const auto lock = std::scoped_lock{d_mutex};
+            --d_pending;
+        }
+    }
+}
+
+auto autosaver::write(job& j) -> void
+{
+    const auto zone = profile_zone{"autosaver::write"};
+
+    // A new size means a new world, every chunk of which was copied as new worlds start
+    // with them all unsaved
+    if (j.width != d_width || j.height != d_height) {
+        d_width = j.width;
+        d_height = j.height;
+        d_blocks.assign((j.width / config::chunk_size) * (j.height / config::chunk_size), {});
+    }
+    for (auto& copy : j.chunks) {
+        d_blocks[copy.index] = copy.page ? encode_page(*copy.page, copy.boards) : std::move(copy.block);
+    }
+
+    const auto out = encode_save(j.width, j.height, j.spawn_point, d_blocks);
+    const auto temp_path = j.file_path + ".tmp";
+    {
+        auto file = std::ofstream{temp_path, std::ios::binary};
+        file.write(reinterpret_cast<const char*>(out.data()), out.size());
+        if (!file) {
+            std::print("Could not write {}\n", temp_path);
+            return;
+        }
+    }
+    auto error = std::error_code{};
+    std::filesystem::rename(temp_path, j.file_path, error);
+    if (error) {
+        std::print("Could not save {}: {}\n", j.file_path, error.message());
+    }
+}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "world.hpp"
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sand {
+
+// Writes saves on a thread of its own, so the simulation never waits on encoding or the
+// disk. Saving only copies the chunks changed since the last save, and the worker keeps
+// the encoded blocks of every chunk between saves, re-encoding just those copies before
+// writing out a whole save. Files are written beside their path and renamed over it, so a
+// save is never left half written.
+class autosaver
+{
+    // A chunk as it was when the save was taken. A paged out chunk is already encoded
+    // so its block is copied instead of its page.
+    struct chunk_copy
+    {
+        std::size_t                 index;
+        std::unique_ptr<chunk_page> page;
+        chunk_bitboards             boards;
+        std::vector<std::byte>      block;
+    };
+
+    struct job
+    {
+        std::string             file_path;
+        std::size_t             width;
+        std::size_t             height;
+        glm::ivec2              spawn_point;
+        std::vector<chunk_copy> chunks;
+    };
+
+    std::mutex                  d_mutex;
+    std::condition_variable_any d_job_ready; // Also woken by the worker's stop token
+    std::vector<job>            d_jobs;
+    std::size_t                 d_pending = 0; // Jobs taken but not yet written
+
+    // Only touched by the worker
+    std::vector<std::vector<std::byte>> d_blocks;
+    std::size_t                         d_width  = 0;
+    std::size_t                         d_height = 0;
+
+    std::jthread d_thread;
+
+    auto run(std::stop_token token) -> void;
+    auto write(job& j) -> void;
+
+    autosaver(const autosaver&) = delete;
+    autosaver& operator=(const autosaver&) = delete;
+
+public:
+    autosaver();
+    ~autosaver(); // Finishes the saves already taken
+
+    // Copies the chunks changed since the last call and queues the save. Not safe to call
+    // during an update.
+    auto save(world& w, const std::string& file_path) -> void;
+
+    // Whether any save is still waiting to be written
+    auto is_busy() -> bool;
+};
+
+}
@@ -0,0 +1,73 @@
+#include "bench.hpp"
+#include "config.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+std::atomic<std::size_t> allocations = 0;
+
+}
+
+auto operator new(std::size_t size) -> void*
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc{};
+}
+
+auto operator delete(void* ptr) noexcept -> void { std::free(ptr); }
+auto operator delete(void* ptr, std::size_t) noexcept -> void { std::free(ptr); }
+
+// Over aligned types, such as the cache line padded ones, come through these instead
+auto operator new(std::size_t size, std::align_val_t align) -> void*
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto alignment = static_cast<std::size_t>(align);
+#ifdef _WIN32
+    if (auto ptr = _aligned_malloc(size ? size : 1, alignment)) return ptr;
+#else
+    // aligned_alloc needs the size to be a multiple of the alignment
+    const auto rounded = (std::max(size, std::size_t{1}) + alignment - 1) / alignment * alignment;
+    if (auto ptr = std::aligned_alloc(alignment, rounded)) return ptr;
+#endif
+    throw std::bad_alloc{};
+}
+
+auto operator delete(void* ptr, std::align_val_t) noexcept -> void
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+auto operator delete(void* ptr, std::size_t, std::align_val_t align) noexcept -> void
+{
+    operator delete(ptr, align);
+}
+
+namespace sand {
+
+auto heap_allocations() -> std::size_t
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+auto new_world(int chunks_width, int chunks_height) -> std::unique_ptr<world>
+{
+    return std::make_unique<world>(
+        config::chunk_size * chunks_width,
+        config::chunk_size * chunks_height
+    );
+}
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "world.hpp"
+
+#include <cstddef>
+#include <memory>
+
+namespace sand {
+
+// Shared by the benchmark executables. Linking bench.cpp into one replaces the global
+// operator new and delete, including the aligned forms, with versions that count every
+// allocation from every thread, so it must never be linked into the editor.
+auto heap_allocations() -> std::size_t;
+
+// An empty world of the given size in chunks
+auto new_world(int chunks_width, int chunks_height) -> std::unique_ptr<world>;
+
+}
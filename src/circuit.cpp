@@ -0,0 +1,245 @@
+#include "circuit.hpp"
+#include "world.hpp"
+#include "pixel.hpp"
+#include "config.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <numeric>
+#include <span>
+#include <utility>
+
+namespace sand {
+namespace {
+
+static constexpr auto adjacent_offsets = std::array{
+    glm::ivec2{1, 0},
+    glm::ivec2{-1, 0},
+    glm::ivec2{0, 1},
+    glm::ivec2{0, -1}
+};
+
+// Calls f with each pixel that could power the one at pos. That is each neighbour, or the
+// pixel beyond a neighbouring relay, that the diodes allow current to flow from.
+auto for_each_input(const pixel_world& pixels, glm::ivec2 pos, auto&& f) -> void
+{
+    const auto dst = pixels[pos].type;
+    for (const auto offset : adjacent_offsets) {
+        if (!pixels.valid(pos + offset)) continue;
+        const auto src = pixels[pos + offset].type;
+
+        // Prevents current from flowing from diode_out to diode_in
+        if (dst == pixel_type::diode_in && src == pixel_type::diode_out) continue;
+
+        // diode_out can *only* be powered by diode_in and itself
+        if (dst == pixel_type::diode_out && src != pixel_type::diode_in && src != pixel_type::diode_out) {
+            continue;
+        }
+
+        if (src == pixel_type::relay) {
+            if (pixels.valid(pos + 2 * offset)) f(pos + 2 * offset);
+        } else {
+            f(pos + offset);
+        }
+    }
+}
+
+// Union find over the sorted node indices, used to split the graph into components
+auto find_root(std::vector<std::uint32_t>& parents, std::uint32_t i) -> std::uint32_t
+{
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+}
+
+auto circuit_network::rebuild(const world& w) -> void
+{
+    const auto zone = profile_zone{"circuit_network::rebuild"};
+    const auto& pixels = w.pixels;
+    d_version = pixels.circuit_version();
+    d_nodes.clear();
+    d_inputs.clear();
+    d_components.clear();
+
+    // Gather every pixel carrying power in index order, so they can be found by searching
+    auto indices = std::vector<std::size_t>{};
+    for (std::size_t chunk = 0; chunk != w.chunks.size(); ++chunk) {
+        const auto& board = pixels.bitboards(chunk).circuit;
+        if (!board.any()) continue;
+        const auto top_left = config::chunk_size * get_chunk_pos(w, chunk);
+        for (int y = 0; y != config::chunk_size; ++y) {
+            for (auto bits = board.row(y); bits; bits &= bits - 1) {
+                const auto pos = top_left + glm::ivec2{std::countr_zero(bits), y};
+                if (pixels[pos].type != pixel_type::relay) {
+                    indices.push_back(pos.x + pixels.width() * pos.y);
+                }
+            }
+        }
+    }
+    std::ranges::sort(indices);
+
+    const auto position = [&](std::size_t index) -> glm::ivec2 {
+        return {index % pixels.width(), index / pixels.width()};
+    };
+    const auto find = [&](glm::ivec2 pos) -> std::uint32_t {
+        const auto it = std::ranges::lower_bound(indices, pos.x + pixels.width() * pos.y);
+        if (it == indices.end() || *it != pos.x + pixels.width() * pos.y) return ~std::uint32_t{0};
+        return static_cast<std::uint32_t>(it - indices.begin());
+    };
+
+    // The edges of each node, in node order, and the components they connect
+    auto edges = std::vector<std::uint32_t>{};
+    auto edge_starts = std::vector<std::uint32_t>(indices.size() + 1);
+    auto parents = std::vector<std::uint32_t>(indices.size());
+    std::iota(parents.begin(), parents.end(), 0u);
+    const auto connect = [&](std::uint32_t a, std::uint32_t b) {
+        parents[find_root(parents, a)] = find_root(parents, b);
+    };
+
+    for (std::uint32_t i = 0; i != indices.size(); ++i) {
+        edge_starts[i] = static_cast<std::uint32_t>(edges.size());
+        const auto pos = position(indices[i]);
+        if (properties(pixels[pos].type).power_type == pixel_power_type::source) {
+            for (const auto offset : adjacent_offsets) {
+                if (!pixels.valid(pos + offset) || pixels[pos + offset].type != pixel_type::diode_out) continue;
+                const auto blocker = find(pos + offset);
+                edges.push_back(blocker);
+                connect(i, blocker);
+            }
+        } else {
+            for_each_input(pixels, pos, [&](glm::ivec2 src) {
+                const auto input = find(src);
+                if (input == ~std::uint32_t{0}) return;
+                edges.push_back(input);
+                connect(i, input);
+            });
+        }
+    }
+    edge_starts[indices.size()] = static_cast<std::uint32_t>(edges.size());
+
+    // Lay the nodes out grouped by component, with components in order of their first node
+    auto component_of = std::vector<std::uint32_t>(indices.size());
+    auto component_ids = std::vector<std::uint32_t>(indices.size(), ~std::uint32_t{0});
+    auto component_sizes = std::vector<std::uint32_t>{};
+    for (std::uint32_t i = 0; i != indices.size(); ++i) {
+        auto& id = component_ids[find_root(parents, i)];
+        if (id == ~std::uint32_t{0}) {
+            id = static_cast<std::uint32_t>(component_sizes.size());
+            component_sizes.push_back(0);
+        }
+        component_of[i] = id;
+        ++component_sizes[id];
+    }
+
+    auto next = std::vector<std::uint32_t>(component_sizes.size());
+    for (std::uint32_t c = 0, start = 0; c != component_sizes.size(); ++c) {
+        d_components.push_back({.first_node = start, .num_nodes = component_sizes[c], .has_source = false, .has_power = true});
+        next[c] = start;
+        start += component_sizes[c];
+    }
+
+    auto final_index = std::vector<std::uint32_t>(indices.size());
+    for (std::uint32_t i = 0; i != indices.size(); ++i) {
+        final_index[i] = next[component_of[i]]++;
+    }
+
+    auto order = std::vector<std::uint32_t>(indices.size());
+    for (std::uint32_t i = 0; i != indices.size(); ++i) {
+        order[final_index[i]] = i;
+    }
+
+    for (const auto i : order) {
+        const auto pos = position(indices[i]);
+        const auto& props = properties(pixels[pos].type);
+        d_nodes.push_back({
+            .pos = pos,
+            .power_max = props.power_max,
+            .is_source = props.power_type == pixel_power_type::source,
+            .explodes_on_power = props.explodes_on_power,
+            .first_input = static_cast<std::uint32_t>(d_inputs.size()),
+            .num_inputs = edge_starts[i + 1] - edge_starts[i]
+        });
+        for (auto e = edge_starts[i]; e != edge_starts[i + 1]; ++e) {
+            d_inputs.push_back(final_index[edges[e]]);
+        }
+        d_components[component_of[i]].has_source |= props.power_type == pixel_power_type::source;
+    }
+
+    d_power.resize(d_nodes.size());
+}
+
+auto circuit_network::step(world& w) -> void
+{
+    const auto zone = profile_zone{"circuit_network::step"};
+    if (d_version != w.pixels.circuit_version()) {
+        rebuild(w);
+    }
+
+    // A source at full power or a node between half and full power feeds its neighbours.
+    // Excluding the maximum means current only flows one node per tick.
+    const auto feeds = [&](std::uint32_t j) {
+        const auto& src = d_nodes[j];
+        const auto power = d_power[j];
+        return (src.is_source && power == src.power_max)
+            || (src.power_max / 2 < power && power < src.power_max);
+    };
+    const auto has_power = [&](std::uint32_t j) { return d_power[j] > 0; };
+
+    for (auto& c : d_components) {
+        if (!c.has_source && !c.has_power) continue;
+
+        // Inputs never cross components, so only this one needs its levels from before
+        for (auto i = c.first_node; i != c.first_node + c.num_nodes; ++i) {
+            d_power[i] = w.pixels[d_nodes[i].pos].power;
+        }
+
+        c.has_power = false;
+        for (auto i = c.first_node; i != c.first_node + c.num_nodes; ++i) {
+            const auto& n = d_nodes[i];
+            const auto inputs = std::span{d_inputs}.subspan(n.first_input, n.num_inputs);
+            auto power = d_power[i];
+
+            if (n.is_source) {
+                if (power < n.power_max) {
+                    ++power;
+                }
+
+                // Powered diode_outs disable power sources
+                if (std::ranges::any_of(inputs, has_power)) {
+                    power = 0;
+                }
+            }
+            else {
+                if (power > 0) {
+                    --power;
+                }
+
+                // Check to see if we should power up just before we hit zero in order to
+                // maintain a current
+                if (power <= 1 && std::ranges::any_of(inputs, feeds)) {
+                    power = n.power_max;
+                }
+
+                if (power > 0 && n.explodes_on_power) {
+                    w.queue_explosion(n.pos, sand::explosion{
+                        .min_radius = 25.0f, .max_radius = 30.0f, .scorch = 10.0f
+                    });
+                }
+            }
+
+            if (power != d_power[i]) {
+                w.pixels[n.pos].power = power;
+                w.redraw_pixel(n.pos);
+            }
+            c.has_power |= power > 0;
+        }
+    }
+}
+
+}
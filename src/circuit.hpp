@@ -0,0 +1,57 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sand {
+
+struct world;
+
+// Simulates power separately from the chunk update. The pixels that carry power are
+// extracted into a graph once, with the relay jumps and diode rules resolved into the
+// inputs of each node, and the graph is rebuilt only when one of those pixels changes.
+//
+// Power moves one node per tick as before, but every node now steps from the levels of the
+// previous tick so the result no longer depends on the scan order. Components with no
+// source and no power are skipped, and changing a power level only redraws the pixel
+// rather than waking its chunk.
+class circuit_network
+{
+    struct node
+    {
+        glm::ivec2    pos;
+        std::uint8_t  power_max;
+        bool          is_source;
+        bool          explodes_on_power;
+        std::uint32_t first_input; // Into d_inputs
+        std::uint32_t num_inputs;  // Nodes that can power this, or for sources the diode_outs that block it
+    };
+
+    struct component
+    {
+        std::uint32_t first_node;
+        std::uint32_t num_nodes;
+        bool          has_source;
+        bool          has_power;   // As of the last step
+    };
+
+    std::vector<node>          d_nodes; // Grouped by component
+    std::vector<std::uint32_t> d_inputs;
+    std::vector<component>     d_components;
+    std::vector<std::uint8_t>  d_power; // The level of each node at the start of the step
+
+    std::uint64_t d_version = ~std::uint64_t{0}; // Of the pixels the graph was built from
+
+    auto rebuild(const world& w) -> void;
+
+public:
+    // Advances power by one tick, rebuilding the graph first if the circuitry has changed
+    auto step(world& w) -> void;
+
+    auto num_nodes() const -> std::size_t { return d_nodes.size(); }
+    auto num_components() const -> std::size_t { return d_components.size(); }
+};
+
+}
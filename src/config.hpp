@@ -1,6 +1,9 @@
 #pragma once
 #include <glm/glm.hpp>
 
+#include <cstddef>
+#include <cstdint>
+
 namespace sand {
 namespace config {
 
@@ -10,6 +13,44 @@ static constexpr auto gravity = glm::vec2{0.0f, 9.81f};
 // Pixel Space
 static constexpr int chunk_size = 64;
 
+// The furthest a pixel can travel in a single step. The parallel scheduler relies on this
+// being well under half a chunk so that chunks two apart never touch the same pixels.
+static constexpr int max_pixel_move = chunk_size / 4;
+
+// Chunks further than this from the player with nothing happening in them have their pixels
+// paged out. They are paged back in from a little closer so edge chunks don't thrash.
+static constexpr float page_out_distance = 1024.0f;
+static constexpr float page_in_distance = 768.0f;
+
+// Chunk colliders are only built and simulated within this many pixels of a dynamic body.
+// They are disabled again a chunk further out so bodies near the edge of the range don't
+// keep toggling them.
+static constexpr float physics_distance = 256.0f;
+static constexpr float physics_disable_distance = physics_distance + chunk_size;
+
+// The solver iterations go from the minimums up towards the maximums by one for each this
+// many touching contacts
+static constexpr int min_velocity_iterations = 4;
+static constexpr int max_velocity_iterations = 8;
+static constexpr int min_position_iterations = 2;
+static constexpr int max_position_iterations = 3;
+static constexpr int contacts_per_iteration = 8;
+
+// Islands of rigid pixels cut loose by explosions become dynamic bodies if they fit in a
+// chunk and have at least this many pixels. They are written back to the world once Box2D
+// puts them to sleep, or after the given number of ticks once slower than the given speed
+// in pixels per second. Pixels landing on occupied cells are moved to the nearest free one
+// within the given distance.
+static constexpr std::size_t min_debris_pixels = 4;
+static constexpr std::size_t max_debris_bodies = 64;
+static constexpr std::uint64_t max_debris_ticks = 600;
+static constexpr float debris_settle_speed = 4.0f;
+static constexpr int debris_displace_distance = 16;
+
+// The world is saved here in the background every this many ticks
+static constexpr auto autosave_interval = std::size_t{60 * 60};
+static constexpr auto autosave_path = "autosave.bin";
+
 // World Space
 static constexpr int pixels_per_meter = 16;
 
@@ -0,0 +1,248 @@
+#include "debris.hpp"
+#include "world.hpp"
+#include "pixel.hpp"
+#include "config.hpp"
+#include "utility.hpp"
+#include "update_rigid_bodies.hpp"
+#include "profiler.hpp"
+#include "scratch.hpp"
+
+#include <box2d/box2d.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace sand {
+namespace {
+
+static constexpr auto side_offsets = std::array{
+    glm::ivec2{1, 0}, glm::ivec2{-1, 0}, glm::ivec2{0, 1}, glm::ivec2{0, -1}
+};
+
+auto is_rigid(pixel_type type) -> bool
+{
+    const auto& props = hot_properties(type);
+    return type != pixel_type::none
+        && props.phase == pixel_phase::solid
+        && props.gravity_factor == 0.0f
+        && !is_circuit_pixel(type);
+}
+
+// Any other solid holds an island up, as does the edge of the world
+auto is_support(pixel_type type) -> bool
+{
+    return type != pixel_type::none && hot_properties(type).phase == pixel_phase::solid;
+}
+
+auto make_body(world& w, glm::ivec2 origin, std::span<const collider_shape> shapes, std::vector<debris_pixel> pixels) -> void
+{
+    b2BodyDef body_def;
+    body_def.type = b2_dynamicBody;
+    body_def.position = pixel_to_physics(origin);
+    auto body = w.physics.CreateBody(&body_def);
+
+    auto vertices = std::vector<b2Vec2>{};
+    for (const auto& shape : shapes) {
+        vertices.clear();
+        for (const auto point : shape) {
+            vertices.push_back(pixel_to_physics(point));
+        }
+        b2PolygonShape polygon;
+        polygon.Set(vertices.data(), static_cast<int>(vertices.size()));
+        b2FixtureDef fixture_def;
+        fixture_def.shape = &polygon;
+        fixture_def.density = 1.0f;
+        fixture_def.friction = 0.6f;
+        body->CreateFixture(&fixture_def);
+    }
+
+    w.debris.push_back(debris_body{
+        .body = body,
+        .pixels = std::make_shared<const std::vector<debris_pixel>>(std::move(pixels)),
+        .created = w.tick
+    });
+}
+
+// Looks outwards from the position a square ring at a time
+auto nearest_air(const world& w, glm::ivec2 pos) -> std::optional<glm::ivec2>
+{
+    for (int r = 0; r <= config::debris_displace_distance; ++r) {
+        for (int dy = -r; dy <= r; ++dy) {
+            const auto step = (dy == -r || dy == r) ? 1 : 2 * r;
+            for (int dx = -r; dx <= r; dx += step) {
+                const auto cell = pos + glm::ivec2{dx, dy};
+                if (w.pixels.valid(cell) && w.pixels[cell].type == pixel_type::none) return cell;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+// The body's pixels are looked up from each cell it covers, rather than each pixel being
+// pushed to a cell, so a rotated piece lands without holes in it. Each pixel is written at
+// most once that way, and the ones left over, whose cells were taken or that no cell landed
+// on, go to the nearest free cell, so no material is lost.
+auto rasterise(world& w, const debris_body& d) -> void
+{
+    auto lookup = std::array<std::int16_t, config::chunk_size * config::chunk_size>{};
+    lookup.fill(-1);
+    auto size = glm::ivec2{0, 0};
+    for (std::size_t i = 0; i != d.pixels->size(); ++i) {
+        const auto offset = (*d.pixels)[i].offset;
+        lookup[offset.x + config::chunk_size * offset.y] = static_cast<std::int16_t>(i);
+        size = glm::max(size, offset + 1);
+    }
+
+    auto min = glm::vec2{std::numeric_limits<float>::max()};
+    auto max = glm::vec2{std::numeric_limits<float>::lowest()};
+    for (const auto corner : {glm::ivec2{0, 0}, glm::ivec2{size.x, 0}, glm::ivec2{0, size.y}, size}) {
+        const auto p = physics_to_pixel(d.body->GetWorldPoint(pixel_to_physics(corner)));
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    auto placed = std::vector<bool>(d.pixels->size(), false);
+    auto written_min = glm::ivec2{std::numeric_limits<int>::max()};
+    auto written_max = glm::ivec2{std::numeric_limits<int>::lowest()};
+    const auto write = [&](glm::ivec2 cell, std::size_t i) {
+        w.pixels[cell] = (*d.pixels)[i].px;
+        placed[i] = true;
+        written_min = glm::min(written_min, cell);
+        written_max = glm::max(written_max, cell);
+    };
+
+    const auto lo = glm::ivec2{glm::floor(min)};
+    const auto hi = glm::ivec2{glm::floor(max)};
+    for (int y = lo.y; y <= hi.y; ++y) {
+        for (int x = lo.x; x <= hi.x; ++x) {
+            const auto cell = glm::ivec2{x, y};
+            if (!w.pixels.valid(cell) || std::as_const(w.pixels)[cell].type != pixel_type::none) continue;
+            const auto local = glm::ivec2{glm::floor(physics_to_pixel(d.body->GetLocalPoint(pixel_to_physics(glm::vec2{cell} + 0.5f))))};
+            if (local.x < 0 || local.y < 0 || local.x >= size.x || local.y >= size.y) continue;
+            const auto i = lookup[local.x + config::chunk_size * local.y];
+            if (i < 0 || placed[i]) continue;
+            write(cell, static_cast<std::size_t>(i));
+        }
+    }
+
+    for (std::size_t i = 0; i != d.pixels->size(); ++i) {
+        if (placed[i]) continue;
+        const auto centre = glm::vec2{(*d.pixels)[i].offset} + 0.5f;
+        const auto pos = glm::ivec2{glm::floor(physics_to_pixel(d.body->GetWorldPoint(pixel_to_physics(centre))))};
+        if (const auto cell = nearest_air(w, pos)) {
+            write(*cell, i);
+        }
+    }
+
+    if (written_min.x <= written_max.x) {
+        w.wake_region(written_min, written_max);
+    }
+}
+
+// Colliders are otherwise only rebuilt from the regions chunks scanned, but the pixels of
+// the region were removed outside of any scan
+auto mark_collider_pending(world& w, glm::ivec2 min, glm::ivec2 max) -> void
+{
+    const auto chunk_lo = min / config::chunk_size;
+    const auto chunk_hi = max / config::chunk_size;
+    for (int y = chunk_lo.y; y <= chunk_hi.y; ++y) {
+        for (int x = chunk_lo.x; x <= chunk_hi.x; ++x) {
+            const auto top_left = config::chunk_size * glm::ivec2{x, y};
+            auto& c = w.chunks[get_chunk_index(w, {x, y})];
+            const auto rect = chunk_rect{
+                glm::max(min, top_left) - top_left,
+                glm::min(max, top_left + config::chunk_size - 1) - top_left
+            };
+            c.collider_pending = merge(c.collider_pending, rect);
+        }
+    }
+}
+
+}
+
+auto carve_debris(world& w, std::span<const glm::ivec2> seeds) -> void
+{
+    const auto zone = profile_zone{"carve_debris"};
+    const auto scope = scratch_scope{w.scratch_epoch}; // Explosion edits carve outside of update
+    const auto key = [&](glm::ivec2 p) { return static_cast<std::uint64_t>(p.y) * w.pixels.width() + p.x; };
+
+    // Pixels reached by an island that turned out to be held up are part of it, so they
+    // are never filled from again
+    auto visited = std::unordered_set<std::uint64_t>{};
+    auto island = std::vector<glm::ivec2>{};
+
+    for (const auto seed : seeds) {
+        if (w.debris.size() >= config::max_debris_bodies) return;
+        if (!w.pixels.valid(seed) || !is_rigid(std::as_const(w.pixels)[seed].type) || !visited.insert(key(seed)).second) continue;
+
+        island.assign(1, seed);
+        auto min = seed;
+        auto max = seed;
+        auto held = false;
+        for (std::size_t i = 0; i != island.size() && !held; ++i) {
+            for (const auto offset : side_offsets) {
+                const auto next = island[i] + offset;
+                if (!w.pixels.valid(next)) { held = true; break; }
+                const auto type = std::as_const(w.pixels)[next].type;
+                if (is_rigid(type)) {
+                    if (!visited.insert(key(next)).second) continue;
+                    island.push_back(next);
+                    min = glm::min(min, next);
+                    max = glm::max(max, next);
+                    if (max.x - min.x >= config::chunk_size || max.y - min.y >= config::chunk_size) { held = true; break; }
+                } else if (is_support(type)) {
+                    held = true;
+                    break;
+                }
+            }
+        }
+        if (held || island.size() < config::min_debris_pixels) continue;
+
+        // Slivers too thin to have an outline stay where they are
+        auto board = chunk_bitboard{};
+        for (const auto pos : island) {
+            board.set(pos - min, true);
+        }
+        const auto shapes = island_collider_shapes(board, {0, 0}, &scratch_arena::for_this_thread(w.scratch_epoch));
+        if (shapes.empty()) continue;
+
+        auto pixels = std::vector<debris_pixel>{};
+        pixels.reserve(island.size());
+        for (const auto pos : island) {
+            pixel px = w.pixels[pos];
+            px.flags[is_updated] = false;
+            px.flags[is_falling] = false;
+            pixels.push_back({pos - min, px});
+            w.pixels[pos] = pixel::air();
+        }
+        w.wake_region(min, max);
+        mark_collider_pending(w, min, max);
+        make_body(w, min, shapes, std::move(pixels));
+    }
+}
+
+auto settle_debris(world& w) -> void
+{
+    if (w.debris.empty()) return;
+    const auto zone = profile_zone{"settle_debris"};
+    std::erase_if(w.debris, [&](const debris_body& d) {
+        const auto centre = physics_to_pixel(d.body->GetWorldCenter());
+        const auto outside = !w.pixels.valid(glm::ivec2{glm::floor(centre)});
+        const auto slow = glm::length(physics_to_pixel(d.body->GetLinearVelocity())) < config::debris_settle_speed;
+        const auto resting = !d.body->IsAwake() || (w.tick - d.created >= config::max_debris_ticks && slow);
+        if (!outside && !resting) return false;
+        if (!outside) rasterise(w, d);
+        w.physics.DestroyBody(d.body);
+        return true;
+    });
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <span>
+
+namespace sand {
+
+struct world;
+
+// Looks for islands of rigid pixels, the solids that don't fall, reachable from the seeds
+// and held up by nothing, such as a slab of rock left floating by an explosion. Each one
+// that fits in a chunk is removed from the pixels and becomes a dynamic body carrying them,
+// so the whole piece falls and tumbles for the cost of one body.
+auto carve_debris(world& w, std::span<const glm::ivec2> seeds) -> void;
+
+// Writes the pixels of debris that has come to rest back into the world where the body
+// lies and destroys the body, moving pixels that land on occupied cells aside. Debris that
+// leaves the world is dropped.
+auto settle_debris(world& w) -> void;
+
+}
@@ -48,10 +48,16 @@ struct editor
         // 0 == circular spray
         // 1 == square
         // 2 == explosion
+        // 3 == circle
         
     bool show_chunks = false;
+    bool show_heatmap = false;
+    int heatmap_metric = 0; // Indexes heatmap_metrics
+    bool gpu_colouring = false; // Apply pixel effects in the shader rather than on the CPU
     bool show_demo = true;
     int zoom = 256;
+
+    int num_threads = 1; // 1 == update chunks in order on the main thread
     
     auto get_pixel() -> sand::pixel
     {
@@ -1,15 +1,55 @@
 #include "explosion.hpp"
+#include "world.hpp"
 #include "utility.hpp"
+#include "config.hpp"
+#include "debris.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtx/norm.hpp>
 
-#include <unordered_set>
+#include <bit>
+#include <utility>
+#include <vector>
 
 namespace sand {
 namespace {
 
-auto explosion_ray(world& w, glm::vec2 start, glm::vec2 end, const explosion& info) -> void
+// What the rays of a batch of explosions do to the pixels of one chunk. Many rays cross
+// the same pixels, especially near the centres, so they only mark the masks and each
+// pixel is then written once. Destroying a pixel takes priority over the rest.
+struct chunk_damage
+{
+    std::size_t    chunk;
+    chunk_bitboard destroyed;
+    chunk_bitboard ignited;  // The first pixel past the blast of a ray, which may catch light
+    chunk_bitboard scorched;
+};
+
+class damage_mask
+{
+    const world&              d_world;
+    std::vector<std::size_t>  d_slots; // Index into d_damage for each chunk, or none
+    std::vector<chunk_damage> d_damage;
+
+    static constexpr auto none = ~std::size_t{0};
+
+public:
+    explicit damage_mask(const world& w) : d_world{w}, d_slots(w.chunks.size(), none) {}
+
+    auto at(glm::ivec2 pos, chunk_bitboard chunk_damage::* mask) -> void
+    {
+        const auto chunk = get_chunk_index(d_world, pos / config::chunk_size);
+        if (d_slots[chunk] == none) {
+            d_slots[chunk] = d_damage.size();
+            d_damage.push_back({.chunk = chunk});
+        }
+        (d_damage[d_slots[chunk]].*mask).set(pos % config::chunk_size, true);
+    }
+
+    auto damage() const -> const std::vector<chunk_damage>& { return d_damage; }
+};
+
+auto explosion_ray(const world& w, damage_mask& mask, glm::vec2 start, glm::vec2 end, const explosion& info) -> void
 {
     // Calculate a step length small enough to hit every pixel on the path.
     const auto line = end - start;
@@ -22,41 +62,95 @@ auto explosion_ray(world& w, glm::vec2 start, glm::vec2 end, const explosion& in
         if (w.pixels[curr].type == pixel_type::titanium) {
             break;
         }
-        w.pixels[curr] = random_unit() < 0.05f ? pixel::ember() : pixel::air();
-        w.wake_chunk_with_pixel(curr);
+        mask.at(curr, &chunk_damage::destroyed);
         curr += step;
     }
-    
+
     // Try to catch light to the first scorched pixel
     if (w.pixels.valid(curr)) {
-        auto& pixel = w.pixels[curr];
-        if (random_unit() < properties(pixel).flammability) {
-            pixel.flags[is_burning] = true;
-            w.wake_chunk_with_pixel(curr);
-        }
+        mask.at(curr, &chunk_damage::ignited);
     }
 
     const auto scorch_limit = glm::length(curr - start) + std::abs(random_normal(0.0f, info.scorch));
     while (w.pixels.valid(curr) && glm::length2(curr - start) < glm::pow(scorch_limit, 2)) {
-        if (properties(w.pixels[curr]).phase == pixel_phase::solid) {
-            w.pixels[curr].colour *= 0.8f;
-            w.wake_chunk_with_pixel(curr);
-        }
+        mask.at(curr, &chunk_damage::scorched);
         curr += step;
     }
 }
 
+// Calls f with the chunk local position of each set bit
+auto for_each_bit(const chunk_bitboard& board, auto&& f) -> void
+{
+    for (int y = 0; y != config::chunk_size; ++y) {
+        for (auto bits = board.rows[y]; bits; bits &= bits - 1) {
+            f(glm::ivec2{std::countr_zero(bits), y});
+        }
+    }
 }
 
-auto apply_explosion(world& pixels, glm::vec2 pos, const explosion& info) -> void
+// The ignited pixels that survive are where the rays stopped, on the edge of the blast,
+// and are given back in edge to look for debris from
+auto apply_damage(world& w, const chunk_damage& damage, std::vector<glm::ivec2>& edge) -> void
 {
-    const auto a = info.max_radius + 3 * info.scorch;
-    for (int b = -a; b != a + 1; ++b) {
-        explosion_ray(pixels, pos, pos + glm::vec2{b, a}, info);
-        explosion_ray(pixels, pos, pos + glm::vec2{b, -a}, info);
-        explosion_ray(pixels, pos, pos + glm::vec2{a, b}, info);
-        explosion_ray(pixels, pos, pos + glm::vec2{-a, b}, info);
+    const auto top_left = config::chunk_size * get_chunk_pos(w, damage.chunk);
+    auto touched = chunk_rect{};
+
+    for_each_bit(damage.destroyed, [&](glm::ivec2 local) {
+        w.pixels[top_left + local] = random_unit() < 0.05f ? pixel::ember() : pixel::air();
+        touched = merge(touched, {local, local});
+    });
+
+    for_each_bit(damage.ignited, [&](glm::ivec2 local) {
+        if (damage.destroyed.test(local)) return;
+        edge.push_back(top_left + local);
+        const auto type = std::as_const(w.pixels)[top_left + local].type;
+        if (random_unit() < properties(type).flammability) {
+            w.pixels[top_left + local].flags[is_burning] = true;
+            touched = merge(touched, {local, local});
+        }
+    });
+
+    for_each_bit(damage.scorched, [&](glm::ivec2 local) {
+        if (damage.destroyed.test(local)) return;
+        const auto type = std::as_const(w.pixels)[top_left + local].type;
+        if (hot_properties(type).phase == pixel_phase::solid) {
+            w.pixels[top_left + local].colour *= 0.8f;
+            touched = merge(touched, {local, local});
+        }
+    });
+
+    if (!touched.empty()) {
+        w.wake_region(top_left + touched.min, top_left + touched.max);
     }
 }
 
-}
\ No newline at end of file
+}
+
+auto apply_explosions(world& w, std::span<const std::pair<glm::vec2, explosion>> explosions) -> void
+{
+    // Overlapping blasts land in the same masks, so a pixel is destroyed if any ray reaches it
+    auto mask = damage_mask{w};
+    for (const auto& [pos, info] : explosions) {
+        const auto a = info.max_radius + 3 * info.scorch;
+        for (int b = -a; b != a + 1; ++b) {
+            explosion_ray(w, mask, pos, pos + glm::vec2{b, a}, info);
+            explosion_ray(w, mask, pos, pos + glm::vec2{b, -a}, info);
+            explosion_ray(w, mask, pos, pos + glm::vec2{a, b}, info);
+            explosion_ray(w, mask, pos, pos + glm::vec2{-a, b}, info);
+        }
+    }
+
+    auto edge = std::vector<glm::ivec2>{};
+    for (const auto& damage : mask.damage()) {
+        apply_damage(w, damage, edge);
+    }
+    carve_debris(w, edge);
+}
+
+auto apply_explosion(world& w, glm::vec2 pos, const explosion& info) -> void
+{
+    const auto single = std::pair{pos, info};
+    apply_explosions(w, {&single, 1});
+}
+
+}
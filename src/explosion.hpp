@@ -1,10 +1,13 @@
 #pragma once
-#include "world.hpp"
-
 #include <glm/glm.hpp>
 
+#include <span>
+#include <utility>
+
 namespace sand {
 
+struct world;
+
 struct explosion
 {
     // Radii from the centre to try and destroy
@@ -16,6 +19,10 @@ struct explosion
     float scorch;
 };
 
-auto apply_explosion(world& pixels, glm::vec2 pos, const explosion& info) -> void;
+// Applies a batch of explosions together. The rays only mark what they hit, and then each
+// pixel is written and each chunk woken once, however many blasts overlap it. Anything the
+// blasts leave floating is carved off as debris.
+auto apply_explosions(world& w, std::span<const std::pair<glm::vec2, explosion>> explosions) -> void;
+auto apply_explosion(world& w, glm::vec2 pos, const explosion& info) -> void;
 
 }
\ No newline at end of file
@@ -2,6 +2,10 @@
 
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
 namespace sand {
 
 void vertex_buffer::set_data(std::size_t size, const void* data) const
@@ -20,4 +24,151 @@ vertex_buffer::~vertex_buffer()
     glDeleteBuffers(1, &d_vbo);
 }
 
+instance_buffer::instance_buffer()
+    : d_buffer{0}
+    , d_mapped{nullptr}
+    , d_section_size{0}
+    , d_current{0}
+    , d_used{0}
+    , d_fences{}
+{}
+
+instance_buffer::~instance_buffer()
+{
+    destroy();
+}
+
+auto instance_buffer::destroy() -> void
+{
+    for (auto& fence : d_fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (d_buffer) {
+        glUnmapNamedBuffer(d_buffer);
+        glDeleteBuffers(1, &d_buffer);
+        d_buffer = 0;
+        d_mapped = nullptr;
+    }
+}
+
+auto instance_buffer::begin_frame(std::size_t bytes) -> void
+{
+    d_used = 0;
+    if (bytes > d_section_size) {
+        // Draws already queued keep the old buffer alive until they have run
+        destroy();
+        d_section_size = std::max({bytes, 2 * d_section_size, std::size_t{64 * 1024}});
+        d_current = 0;
+
+        const auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const auto size = num_sections * d_section_size;
+        glCreateBuffers(1, &d_buffer);
+        glNamedBufferStorage(d_buffer, size, nullptr, flags);
+        d_mapped = static_cast<std::byte*>(glMapNamedBufferRange(d_buffer, 0, size, flags));
+        return;
+    }
+
+    auto& fence = d_fences[d_current];
+    if (fence) {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+auto instance_buffer::push_bytes(std::span<const std::byte> data) -> std::size_t
+{
+    assert(d_used + data.size() <= d_section_size);
+    const auto offset = d_current * d_section_size + d_used;
+    if (!data.empty()) {
+        std::memcpy(d_mapped + offset, data.data(), data.size());
+    }
+    d_used += data.size();
+    return offset;
+}
+
+auto instance_buffer::end_frame() -> void
+{
+    d_fences[d_current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    d_current = (d_current + 1) % num_sections;
+}
+
+pixel_buffer::pixel_buffer()
+    : d_buffer{0}
+    , d_mapped{nullptr}
+    , d_section_size{0}
+    , d_current{0}
+    , d_fences{}
+{}
+
+pixel_buffer::~pixel_buffer()
+{
+    destroy();
+}
+
+auto pixel_buffer::destroy() -> void
+{
+    for (auto& fence : d_fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (d_buffer) {
+        glUnmapNamedBuffer(d_buffer);
+        glDeleteBuffers(1, &d_buffer);
+        d_buffer = 0;
+        d_mapped = nullptr;
+    }
+}
+
+auto pixel_buffer::resize(std::size_t num_pixels) -> void
+{
+    destroy();
+
+    d_section_size = num_pixels;
+    d_current = 0;
+
+    const auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const auto bytes = num_sections * d_section_size * sizeof(std::uint32_t);
+    glCreateBuffers(1, &d_buffer);
+    glNamedBufferStorage(d_buffer, bytes, nullptr, flags);
+    d_mapped = static_cast<std::uint32_t*>(glMapNamedBufferRange(d_buffer, 0, bytes, flags));
+}
+
+auto pixel_buffer::begin_frame() -> std::span<std::uint32_t>
+{
+    auto& fence = d_fences[d_current];
+    if (fence) {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    return {d_mapped + d_current * d_section_size, d_section_size};
+}
+
+auto pixel_buffer::end_frame() -> void
+{
+    d_fences[d_current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    d_current = (d_current + 1) % num_sections;
+}
+
+auto pixel_buffer::section_offset() const -> std::size_t
+{
+    return d_current * d_section_size * sizeof(std::uint32_t);
+}
+
+auto pixel_buffer::bind() const -> void
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, d_buffer);
+}
+
+auto pixel_buffer::unbind() const -> void
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
 }
\ No newline at end of file
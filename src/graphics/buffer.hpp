@@ -1,7 +1,11 @@
 #pragma once
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <span>
 
+struct __GLsync;
+
 namespace sand {
 
 class vertex_buffer
@@ -18,10 +22,94 @@ public:
     ~vertex_buffer();
 
     template <typename T> 
-    void bind(std::span<const T> data) const { 
-        T::set_buffer_attributes(d_vbo);
+    void set(std::span<const T> data) const { 
         set_data(data.size_bytes(), data.data());
     }
+
+    auto id() const -> std::uint32_t { return d_vbo; }
+};
+
+// A persistently mapped buffer for streaming instance data, split into sections used on
+// successive frames in the same way as pixel_buffer. Data is pushed into the current
+// section and drawn from at the returned offset. The sections grow to fit the largest
+// frame seen, which only reallocates while the amount drawn is still climbing.
+class instance_buffer
+{
+    static constexpr std::size_t num_sections = 3;
+
+    std::uint32_t d_buffer;
+    std::byte*    d_mapped;
+    std::size_t   d_section_size; // In bytes
+    std::size_t   d_current;
+    std::size_t   d_used;
+
+    std::array<__GLsync*, num_sections> d_fences;
+
+    auto destroy() -> void;
+    auto push_bytes(std::span<const std::byte> data) -> std::size_t;
+
+    instance_buffer(const instance_buffer&) = delete;
+    instance_buffer& operator=(const instance_buffer&) = delete;
+
+public:
+    instance_buffer();
+    ~instance_buffer();
+
+    // Waits until the GPU is done with the next section, making room for at least the
+    // given number of bytes to be pushed this frame
+    auto begin_frame(std::size_t bytes) -> void;
+
+    // Copies the data into the current section, returning its offset in bytes from the
+    // start of the buffer
+    template <typename T>
+    auto push(std::span<const T> data) -> std::size_t
+    {
+        return push_bytes(std::as_bytes(data));
+    }
+
+    // Fences the current section so it isn't written again until the draws have run
+    auto end_frame() -> void;
+
+    auto id() const -> std::uint32_t { return d_buffer; }
+};
+
+// A persistently mapped buffer for streaming pixels to textures. It is split into two
+// sections used on alternate frames, so writing one never waits for the GPU to finish
+// reading the other. Upload from it with texture::set_region while bound.
+class pixel_buffer
+{
+    static constexpr std::size_t num_sections = 2;
+
+    std::uint32_t  d_buffer;
+    std::uint32_t* d_mapped;
+    std::size_t    d_section_size; // In pixels
+    std::size_t    d_current;
+
+    std::array<__GLsync*, num_sections> d_fences;
+
+    auto destroy() -> void;
+
+    pixel_buffer(const pixel_buffer&) = delete;
+    pixel_buffer& operator=(const pixel_buffer&) = delete;
+
+public:
+    pixel_buffer();
+    ~pixel_buffer();
+
+    auto resize(std::size_t num_pixels) -> void;
+
+    // Waits until the GPU is done with the next section and returns it for writing
+    auto begin_frame() -> std::span<std::uint32_t>;
+
+    // Fences the current section so it isn't written again until the uploads have run
+    auto end_frame() -> void;
+
+    // The offset in bytes of the current section, for converting section indices into
+    // the offsets passed to texture::set_region
+    auto section_offset() const -> std::size_t;
+
+    auto bind() const -> void;
+    auto unbind() const -> void;
 };
 
 }
\ No newline at end of file
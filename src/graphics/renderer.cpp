@@ -2,11 +2,17 @@
 #include "utility.hpp"
 #include "pixel.hpp"
 #include "camera.hpp"
+#include "profiler.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <array>
+#include <format>
+#include <utility>
+
 namespace sand {
 namespace {
 
@@ -33,20 +39,81 @@ void main()
 }
 )SHADER";
 
+// When gpu colouring is on, u_texture holds the base colours and u_state holds the type,
+// burning flag, power and chunk highlight of each pixel, and the effects are applied here
 constexpr auto fragment_shader = R"SHADER(
 #version 410 core
 layout (location = 0) out vec4 out_colour;
 
 in vec2 pass_uv;
 
-uniform sampler2D u_texture;
+uniform sampler2D  u_texture;
+uniform usampler2D u_state;
+uniform bool       u_gpu_colouring;
+uniform float      u_seed;
+
+// Indexed by pixel type
+uniform int   u_power_type[32]; // 0 == none, 1 == source, 2 == conductor
+uniform float u_power_max[32];
+
+uniform vec4 u_fire_colours[3];
+uniform vec4 u_electricity_colours[2];
+
+float random(vec2 pos)
+{
+    return fract(sin(dot(pos + u_seed, vec2(12.9898, 78.233))) * 43758.5453);
+}
 
 void main()
 {
-    out_colour = texture(u_texture, pass_uv);
+    vec4 colour = texture(u_texture, pass_uv);
+
+    if (u_gpu_colouring) {
+        uvec4 state = texture(u_state, pass_uv);
+        int   type  = int(state.r);
+        float t     = float(state.b) / max(u_power_max[type], 1.0);
+        float r     = random(pass_uv * vec2(textureSize(u_texture, 0)));
+
+        if (state.g != 0u) {
+            colour = u_fire_colours[min(int(r * 3.0), 2)];
+        }
+        else if (u_power_type[type] == 1) {
+            colour = mix(vec4(0, 0, 0, 1), colour, t);
+        }
+        else if (u_power_type[type] == 2) {
+            colour = mix(colour, u_electricity_colours[min(int(r * 2.0), 1)], t);
+        }
+
+        if (state.a != 0u) {
+            colour += vec4(0.05, 0.05, 0.05, 0);
+        }
+    }
+
+    out_colour = colour;
 }
 )SHADER";
 
+static constexpr auto num_shader_types = 32;
+static_assert(static_cast<int>(pixel_type::relay) < num_shader_types);
+
+const auto fire_colours = std::array{
+    from_hex(0xe55039), from_hex(0xf6b93b), from_hex(0xfad390)
+};
+
+const auto electricity_colours = std::array{
+    from_hex(0xf6e58d), from_hex(0xf9ca24)
+};
+
+auto shader_power_type(pixel_power_type type) -> int
+{
+    switch (type) {
+        case pixel_power_type::none: return 0;
+        case pixel_power_type::source: return 1;
+        case pixel_power_type::conductor: return 2;
+    }
+    std::unreachable();
+}
+
 auto light_noise(glm::vec4 vec) -> glm::vec4
 {
     return {
@@ -64,7 +131,8 @@ renderer::renderer(std::size_t width, std::size_t height)
     , d_vbo{0}
     , d_ebo{0}
     , d_texture{}
-    , d_texture_data{}
+    , d_state_texture{texture_format::rgba8ui}
+    , d_pixel_buffer{}
     , d_shader{vertex_shader, fragment_shader}
 {
     const float vertices[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
@@ -86,6 +154,19 @@ renderer::renderer(std::size_t width, std::size_t height)
 
     d_shader.bind();
     d_shader.load_sampler("u_texture", 0);
+    d_shader.load_sampler("u_state", 1);
+
+    for (int i = 0; i != num_shader_types; ++i) {
+        const auto& props = properties(static_cast<pixel_type>(std::min(i, static_cast<int>(pixel_type::relay))));
+        d_shader.load_int(std::format("u_power_type[{}]", i).c_str(), shader_power_type(props.power_type));
+        d_shader.load_float(std::format("u_power_max[{}]", i).c_str(), props.power_max);
+    }
+    for (std::size_t i = 0; i != fire_colours.size(); ++i) {
+        d_shader.load_vec4(std::format("u_fire_colours[{}]", i).c_str(), fire_colours[i]);
+    }
+    for (std::size_t i = 0; i != electricity_colours.size(); ++i) {
+        d_shader.load_vec4(std::format("u_electricity_colours[{}]", i).c_str(), electricity_colours[i]);
+    }
 
     resize(width, height);
 }
@@ -101,69 +182,101 @@ auto renderer::bind() const -> void
 {
     glBindVertexArray(d_vao);
     d_shader.bind();
+    d_texture.bind(0);
+    d_state_texture.bind(1);
 }
 
-auto renderer::update(const world& world, bool show_chunks, const camera& camera) -> void
+auto renderer::update(const world_snapshot& snapshot, bool gpu_colouring, const camera& camera) -> void
 {
-    if (d_texture.width() != world.pixels.width() || d_texture.height() != world.pixels.height()) {
-        resize(world.pixels.width(), world.pixels.height());
+    const auto zone = profile_zone{"renderer::update"};
+    if (d_texture.width() != snapshot.width || d_texture.height() != snapshot.height) {
+        resize(snapshot.width, snapshot.height);
     }
 
-    static const auto fire_colours = std::array{
-        from_hex(0xe55039), from_hex(0xf6b93b), from_hex(0xfad390)
-    };
-
-    static const auto electricity_colours = std::array{
-        from_hex(0xf6e58d), from_hex(0xf9ca24)
-    };
+    // Switching mode changes what every pixel in the textures means
+    if (gpu_colouring != d_gpu_colouring) {
+        d_gpu_colouring = gpu_colouring;
+        d_upload_everything = true;
+    }
+    if (snapshot.everything) {
+        d_upload_everything = false;
+    }
 
+    d_shader.load_int("u_gpu_colouring", gpu_colouring);
+    d_shader.load_float("u_seed", random_unit());
     d_shader.load_vec2("u_tex_offset", camera.top_left);
     d_shader.load_float("u_world_to_screen", camera.world_to_screen);
 
     const auto projection = glm::ortho(0.0f, camera.screen_width, camera.screen_height, 0.0f);
     d_shader.load_mat4("u_proj_matrix", projection);
 
-    const auto& chunks = world.chunks;
-    for (std::size_t index = 0; index != chunks.size(); ++index) {
-        if (!chunks[index].should_step && !show_chunks) continue;
-
-        const auto top_left = sand::config::chunk_size * get_chunk_pos(world, index);
-        for (std::size_t x = 0; x != sand::config::chunk_size; ++x) {
-            for (std::size_t y = 0; y != sand::config::chunk_size; ++y) {
-                const auto world_coord = top_left + glm::ivec2{x, y};
-
-                auto& colour = d_texture_data[world_coord.x + d_texture.width() * world_coord.y];
-
-                const auto& pixel = world.pixels[world_coord];
-                const auto& props = properties(pixel);
-
-                if (pixel.flags[is_burning]) {
-                    colour = sand::random_element(fire_colours);
+    // Each chunk gets its own block of the staging buffer, and only the part of it covering
+    // the region in the snapshot is written to and uploaded. The state blocks come after all
+    // of the colour blocks.
+    static constexpr auto block_size = sand::config::chunk_size * sand::config::chunk_size;
+    const auto staging = [&] {
+        const auto wait_zone = profile_zone{"pixel_buffer::begin_frame"};
+        return d_pixel_buffer.begin_frame();
+    }();
+    const auto state_start = staging.size() / 2;
+    d_pixel_buffer.bind();
+
+    for (const auto& chunk : snapshot.chunks) {
+        const auto index = chunk.index;
+        const auto rect = chunk.rect;
+        const auto rect_size = rect.max - rect.min + 1;
+        const auto block = staging.subspan(index * block_size, block_size);
+        const auto state_block = staging.subspan(state_start + index * block_size, block_size);
+        const auto top_left = sand::config::chunk_size * glm::ivec2{
+            index % (snapshot.width / config::chunk_size), index / (snapshot.width / config::chunk_size)
+        };
+
+        if (gpu_colouring) {
+            std::ranges::copy(chunk.colours, block.begin());
+            std::ranges::copy(chunk.states, state_block.begin());
+        }
+        else {
+            for (std::size_t i = 0; i != chunk.states.size(); ++i) {
+                const auto state = chunk.states[i];
+                const auto type = state_type(state);
+                const auto& props = properties(type);
+                const auto power = state_power(state);
+
+                auto& colour = block[i];
+                colour = chunk.colours[i];
+
+                if (state_burning(state)) {
+                    colour = to_rgba8(sand::random_element(fire_colours));
                 }
                 else if (props.power_type == pixel_power_type::source) {
                     const auto a = from_hex(0x000000); // black
-                    const auto b = pixel.colour;
-                    const auto t = static_cast<float>(pixel.power) / props.power_max;
-                    colour = sand::lerp(a, b, t);
+                    const auto b = from_rgba8(chunk.colours[i]);
+                    const auto t = static_cast<float>(power) / props.power_max;
+                    colour = to_rgba8(sand::lerp(a, b, t));
                 }
                 else if (props.power_type == pixel_power_type::conductor) {
-                    const auto a = pixel.colour;
+                    const auto a = from_rgba8(chunk.colours[i]);
                     const auto b = sand::random_element(electricity_colours);
-                    const auto t = static_cast<float>(pixel.power) / props.power_max;
-                    colour = sand::lerp(a, b, t);
-                }
-                else {
-                    colour = pixel.colour;
+                    const auto t = static_cast<float>(power) / props.power_max;
+                    colour = to_rgba8(sand::lerp(a, b, t));
                 }
 
-                if (show_chunks && chunks[index].should_step) {
-                    colour += glm::vec4{0.05, 0.05, 0.05, 0};
+                if (state_scanned(state)) {
+                    colour = to_rgba8(from_rgba8(colour) + glm::vec4{0.05, 0.05, 0.05, 0});
                 }
             }
         }
+
+        const auto offset = d_pixel_buffer.section_offset() + index * block_size * sizeof(std::uint32_t);
+        d_texture.set_region(top_left + rect.min, rect_size, offset);
+        if (gpu_colouring) {
+            const auto state_offset = offset + state_start * sizeof(std::uint32_t);
+            d_state_texture.set_region(top_left + rect.min, rect_size, state_offset);
+        }
     }
 
-    d_texture.set_data(d_texture_data);
+    d_pixel_buffer.unbind();
+    d_pixel_buffer.end_frame();
 }
 
 auto renderer::draw() const -> void
@@ -174,7 +287,9 @@ auto renderer::draw() const -> void
 auto renderer::resize(std::size_t width, std::size_t height) -> void
 {
     d_texture.resize(width, height);
-    d_texture_data.resize(width * height);
+    d_state_texture.resize(width, height);
+    d_pixel_buffer.resize(2 * width * height);
+    d_upload_everything = true;
 }
 
 }
\ No newline at end of file
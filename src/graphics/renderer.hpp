@@ -1,7 +1,8 @@
 #pragma once
 #include "graphics/texture.hpp"
 #include "graphics/shader.hpp"
-#include "world.hpp"
+#include "graphics/buffer.hpp"
+#include "snapshot.hpp"
 #include "camera.hpp"
 
 #include <glm/glm.hpp>
@@ -18,8 +19,12 @@ class renderer
     std::uint32_t d_vbo;
     std::uint32_t d_ebo;
 
-    texture                d_texture;
-    std::vector<glm::vec4> d_texture_data;
+    texture      d_texture;
+    texture      d_state_texture;
+    pixel_buffer d_pixel_buffer;
+
+    bool d_gpu_colouring = false;
+    bool d_upload_everything = true;
 
     shader d_shader;
 
@@ -32,7 +37,17 @@ public:
 
     auto bind() const -> void;
 
-    auto update(const world& world, bool show_chunks, const camera& camera) -> void;
+    // Uploads the regions in the snapshot. With gpu_colouring the fire, power and highlight
+    // effects are applied in the fragment shader from an extra state texture instead of
+    // being baked into the colours here.
+    auto update(const world_snapshot& snapshot, bool gpu_colouring, const camera& camera) -> void;
+
+    // Whether the next snapshot should have every chunk, such as after a resize or a
+    // change of colouring mode
+    auto needs_everything(bool gpu_colouring) const -> bool
+    {
+        return d_upload_everything || gpu_colouring != d_gpu_colouring;
+    }
 
     auto draw() const -> void;
 
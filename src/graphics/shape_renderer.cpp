@@ -1,4 +1,5 @@
 #include "shape_renderer.hpp"
+#include "profiler.hpp"
 
 #include <glad/glad.h>
 
@@ -6,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <cstddef>
+#include <span>
 
 namespace sand {
 namespace {
@@ -237,49 +239,49 @@ void main()
 
 }
 
-void line_instance::set_buffer_attributes(std::uint32_t vbo)
+void line_instance::set_buffer_attributes(std::uint32_t vbo, std::size_t offset)
 {
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     for (int i = 1; i != 6; ++i) {
         glEnableVertexAttribArray(i);
         glVertexAttribDivisor(i, 1);
     }
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)offsetof(line_instance, begin));
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)offsetof(line_instance, end));
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)offsetof(line_instance, begin_colour));
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)offsetof(line_instance, end_colour));
-    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)offsetof(line_instance, thickness));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)(offset + offsetof(line_instance, begin)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)(offset + offsetof(line_instance, end)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)(offset + offsetof(line_instance, begin_colour)));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)(offset + offsetof(line_instance, end_colour)));
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(line_instance), (void*)(offset + offsetof(line_instance, thickness)));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void circle_instance::set_buffer_attributes(std::uint32_t vbo)
+void circle_instance::set_buffer_attributes(std::uint32_t vbo, std::size_t offset)
 {
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     for (int i = 1; i != 7; ++i) {
         glEnableVertexAttribArray(i);
         glVertexAttribDivisor(i, 1);
     }
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)offsetof(circle_instance, centre));
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)offsetof(circle_instance, inner_radius));
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)offsetof(circle_instance, outer_radius));
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)offsetof(circle_instance, begin_colour));
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)offsetof(circle_instance, end_colour));
-    glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)offsetof(circle_instance, angle));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)(offset + offsetof(circle_instance, centre)));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)(offset + offsetof(circle_instance, inner_radius)));
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)(offset + offsetof(circle_instance, outer_radius)));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)(offset + offsetof(circle_instance, begin_colour)));
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)(offset + offsetof(circle_instance, end_colour)));
+    glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void*)(offset + offsetof(circle_instance, angle)));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void quad_instance::set_buffer_attributes(std::uint32_t vbo)
+void quad_instance::set_buffer_attributes(std::uint32_t vbo, std::size_t offset)
 {
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     for (int i = 1; i != 6; ++i) {
         glEnableVertexAttribArray(i);
         glVertexAttribDivisor(i, 1);
     }
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)offsetof(quad_instance, centre));
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)offsetof(quad_instance, width));
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)offsetof(quad_instance, height));
-    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)offsetof(quad_instance, angle));
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)offsetof(quad_instance, colour));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)(offset + offsetof(quad_instance, centre)));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)(offset + offsetof(quad_instance, width)));
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)(offset + offsetof(quad_instance, height)));
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)(offset + offsetof(quad_instance, angle)));
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(quad_instance), (void*)(offset + offsetof(quad_instance, colour)));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -341,27 +343,56 @@ void shape_renderer::begin_frame(const camera& c)
 
 void shape_renderer::end_frame()
 {
+    const auto zone = profile_zone{"shape_renderer::end_frame"};
     glBindVertexArray(d_vao);
 
     glEnable(GL_BLEND);
     glBlendEquation(GL_FUNC_ADD);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    d_quad_shader.bind();
-    d_instances.bind<quad_instance>(d_quads);
-    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (int)d_quads.size());
+    // Everything drawn this frame goes into one section of the ring, one range per shape
+    const auto bytes = std::span{d_quads}.size_bytes()
+                     + std::span{d_lines}.size_bytes()
+                     + std::span{d_circles}.size_bytes();
+    d_instances.begin_frame(bytes);
+    const auto quads_offset = d_instances.push<quad_instance>(d_quads);
+    const auto lines_offset = d_instances.push<line_instance>(d_lines);
+    const auto circles_offset = d_instances.push<circle_instance>(d_circles);
+
+    if (!d_quads.empty()) {
+        d_quad_shader.bind();
+        quad_instance::set_buffer_attributes(d_instances.id(), quads_offset);
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (int)d_quads.size());
+    }
 
-    d_line_shader.bind();
-    d_instances.bind<line_instance>(d_lines);
-    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (int)d_lines.size());
+    if (d_num_cached_lines > 0 || !d_lines.empty()) {
+        d_line_shader.bind();
+    }
+    if (d_num_cached_lines > 0) {
+        line_instance::set_buffer_attributes(d_cached_lines.id(), 0);
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (int)d_num_cached_lines);
+    }
+    if (!d_lines.empty()) {
+        line_instance::set_buffer_attributes(d_instances.id(), lines_offset);
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (int)d_lines.size());
+    }
 
-    d_circle_shader.bind();
-    d_instances.bind<circle_instance>(d_circles);
-    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (int)d_circles.size());
+    if (!d_circles.empty()) {
+        d_circle_shader.bind();
+        circle_instance::set_buffer_attributes(d_instances.id(), circles_offset);
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (int)d_circles.size());
+    }
 
+    d_instances.end_frame();
     glDisable(GL_BLEND);
 }
 
+void shape_renderer::set_cached_lines(std::span<const line_instance> lines)
+{
+    d_cached_lines.set(lines);
+    d_num_cached_lines = lines.size();
+}
+
 void shape_renderer::draw_quad(
     const glm::vec2& centre,
     const float      width,
@@ -5,7 +5,10 @@
 
 #include <glm/glm.hpp>
 
+#include <cstddef>
 #include <memory>
+#include <span>
+#include <vector>
 
 namespace sand {
 
@@ -17,7 +20,7 @@ struct line_instance
     glm::vec4 end_colour;
     float     thickness;
 
-    static void set_buffer_attributes(std::uint32_t vbo);
+    static void set_buffer_attributes(std::uint32_t vbo, std::size_t offset);
 };
 
 struct circle_instance
@@ -29,7 +32,7 @@ struct circle_instance
     glm::vec4 end_colour;
     float     angle;
 
-    static void set_buffer_attributes(std::uint32_t vbo);
+    static void set_buffer_attributes(std::uint32_t vbo, std::size_t offset);
 };
 
 struct quad_instance
@@ -40,7 +43,7 @@ struct quad_instance
     float     angle;
     glm::vec4 colour;
 
-    static void set_buffer_attributes(std::uint32_t vbo);
+    static void set_buffer_attributes(std::uint32_t vbo, std::size_t offset);
 };
 
 class shape_renderer
@@ -57,7 +60,10 @@ class shape_renderer
     shader d_line_shader;
     shader d_circle_shader;
 
-    vertex_buffer d_instances;
+    instance_buffer d_instances;
+
+    vertex_buffer d_cached_lines;
+    std::size_t   d_num_cached_lines = 0;
 
 public:
     shape_renderer();
@@ -95,6 +101,10 @@ public:
         const float      radius
     );
 
+    // Lines kept on the GPU and drawn every frame until replaced, for overlays that change
+    // far less often than they are drawn
+    void set_cached_lines(std::span<const line_instance> lines);
+
     void draw_annulus(
         const glm::vec2& centre,
         const glm::vec4& colour,
@@ -3,16 +3,44 @@
 #include <glad/glad.h>
 
 #include <cassert>
+#include <utility>
 
 namespace sand {
 
-texture::texture(std::uint32_t width, std::uint32_t height)
+namespace {
+
+auto internal_format(texture_format format) -> GLenum
+{
+    switch (format) {
+        case texture_format::rgba8: return GL_RGBA8;
+        case texture_format::rgba8ui: return GL_RGBA8UI;
+    }
+    std::unreachable();
+}
+
+auto pixel_format(texture_format format) -> GLenum
+{
+    switch (format) {
+        case texture_format::rgba8: return GL_RGBA;
+        case texture_format::rgba8ui: return GL_RGBA_INTEGER;
+    }
+    std::unreachable();
+}
+
+}
+
+texture::texture(std::uint32_t width, std::uint32_t height, texture_format format)
     : d_texture{0}
+    , d_format{format}
 {
     resize(width, height);
 }
 
-texture::texture()
+texture::texture(texture_format format)
+    : d_texture{0}
+    , d_width{0}
+    , d_height{0}
+    , d_format{format}
 {}
 
 texture::~texture()
@@ -20,16 +48,19 @@ texture::~texture()
     glDeleteTextures(1, &d_texture);
 }
 
-auto texture::set_data(std::span<const glm::vec4> data) -> void
+auto texture::set_region(glm::ivec2 top_left, glm::ivec2 size, std::size_t buffer_offset) -> void
 {
-    assert(data.size() == d_width * d_height);
-    bind();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, d_width, d_height, 0, GL_RGBA, GL_FLOAT, data.data());
+    assert(0 <= top_left.x && top_left.x + size.x <= d_width);
+    assert(0 <= top_left.y && top_left.y + size.y <= d_height);
+    glTextureSubImage2D(
+        d_texture, 0, top_left.x, top_left.y, size.x, size.y,
+        pixel_format(d_format), GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(buffer_offset)
+    );
 }
 
-auto texture::bind() const -> void
+auto texture::bind(std::uint32_t unit) const -> void
 {
-    glBindTexture(GL_TEXTURE_2D, d_texture);
+    glBindTextureUnit(unit, d_texture);
 }
 
 auto texture::resize(std::uint32_t width, std::uint32_t height) -> void
@@ -42,12 +73,15 @@ auto texture::resize(std::uint32_t width, std::uint32_t height) -> void
     d_height = height;
 
     glGenTextures(1, &d_texture);
-    bind();
+    glBindTexture(GL_TEXTURE_2D, d_texture);
     glTextureParameteri(d_texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTextureParameteri(d_texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTextureParameteri(d_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTextureParameteri(d_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexImage2D(
+        GL_TEXTURE_2D, 0, internal_format(d_format), width, height, 0,
+        pixel_format(d_format), GL_UNSIGNED_BYTE, nullptr
+    );
 }
 
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <span>
 
@@ -6,22 +7,31 @@
 
 namespace sand {
 
+enum class texture_format
+{
+    rgba8,   // Normalised colours
+    rgba8ui, // Four raw bytes, read with a usampler
+};
+
 class texture
 {
-    std::uint32_t d_texture;
-    std::uint32_t d_width;
-    std::uint32_t d_height;
+    std::uint32_t  d_texture;
+    std::uint32_t  d_width;
+    std::uint32_t  d_height;
+    texture_format d_format;
 
     texture(const texture&) = delete;
     texture& operator=(const texture&) = delete;
 
 public:
-    texture();
-    texture(std::uint32_t width, std::uint32_t height);
+    explicit texture(texture_format format = texture_format::rgba8);
+    texture(std::uint32_t width, std::uint32_t height, texture_format format = texture_format::rgba8);
     ~texture();
 
-    auto set_data(std::span<const glm::vec4> data) -> void;
-    auto bind() const -> void;
+    // Copies a region of four byte pixels, stored row by row with no padding, from the bound
+    // pixel_buffer at the given byte offset
+    auto set_region(glm::ivec2 top_left, glm::ivec2 size, std::size_t buffer_offset) -> void;
+    auto bind(std::uint32_t unit) const -> void;
 
     auto resize(std::uint32_t width, std::uint32_t height) -> void;
 
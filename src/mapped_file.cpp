@@ -0,0 +1,106 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sand {
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const std::string& file_path)
+{
+    d_file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (d_file == INVALID_HANDLE_VALUE) {
+        d_file = nullptr;
+        return;
+    }
+
+    auto size = LARGE_INTEGER{};
+    if (!GetFileSizeEx(d_file, &size) || size.QuadPart == 0) {
+        close();
+        return;
+    }
+
+    d_mapping = CreateFileMappingA(d_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!d_mapping) {
+        close();
+        return;
+    }
+
+    d_data = static_cast<const std::byte*>(MapViewOfFile(d_mapping, FILE_MAP_READ, 0, 0, 0));
+    d_size = d_data ? static_cast<std::size_t>(size.QuadPart) : 0;
+    if (!d_data) {
+        close();
+    }
+}
+
+auto mapped_file::close() -> void
+{
+    if (d_data) {
+        UnmapViewOfFile(d_data);
+        d_data = nullptr;
+        d_size = 0;
+    }
+    if (d_mapping) {
+        CloseHandle(d_mapping);
+        d_mapping = nullptr;
+    }
+    if (d_file) {
+        CloseHandle(d_file);
+        d_file = nullptr;
+    }
+}
+
+#else
+
+mapped_file::mapped_file(const std::string& file_path)
+{
+    d_file = ::open(file_path.c_str(), O_RDONLY);
+    if (d_file < 0) return;
+
+    struct stat info;
+    if (::fstat(d_file, &info) != 0 || info.st_size == 0) {
+        close();
+        return;
+    }
+
+    const auto size = static_cast<std::size_t>(info.st_size);
+    const auto mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, d_file, 0);
+    if (mapped == MAP_FAILED) {
+        close();
+        return;
+    }
+
+    // The blocks are decoded in parallel from every part of the file at once
+    ::madvise(mapped, size, MADV_WILLNEED);
+    d_data = static_cast<const std::byte*>(mapped);
+    d_size = size;
+}
+
+auto mapped_file::close() -> void
+{
+    if (d_data) {
+        ::munmap(const_cast<std::byte*>(d_data), d_size);
+        d_data = nullptr;
+        d_size = 0;
+    }
+    if (d_file >= 0) {
+        ::close(d_file);
+        d_file = -1;
+    }
+}
+
+#endif
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace sand {
+
+// A read only view of a whole file mapped into memory, so large files can be read without
+// first copying them onto the heap. Pages of the file are only read in as they are touched.
+class mapped_file
+{
+    const std::byte* d_data = nullptr;
+    std::size_t      d_size = 0;
+#ifdef _WIN32
+    void*            d_file = nullptr;
+    void*            d_mapping = nullptr;
+#else
+    int              d_file = -1;
+#endif
+
+    auto close() -> void;
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+public:
+    // Leaves the view empty if the file cannot be opened or mapped
+    explicit mapped_file(const std::string& file_path);
+    ~mapped_file();
+
+    auto is_open() const -> bool { return d_data != nullptr; }
+    auto data() const -> std::span<const std::byte> { return {d_data, d_size}; }
+};
+
+}
@@ -49,6 +49,12 @@ auto keyboard::on_new_frame() -> void
     d_down_this_frame.reset();
 }
 
+auto keyboard::hold(const keyboard& latest) -> void
+{
+    d_down = latest.d_down;
+    d_down_this_frame |= latest.d_down_this_frame;
+}
+
 auto keyboard::is_down(keyboard_key key) const -> bool
 {
     return d_down.test(std::to_underlying(key));
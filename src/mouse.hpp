@@ -43,8 +43,13 @@ public:
     auto on_event(const event& e) -> void;
     auto on_new_frame() -> void;
 
+    // Takes the keys held in the latest state, keeping any presses not yet seen
+    auto hold(const keyboard& latest) -> void;
+
     auto is_down(keyboard_key key) const -> bool;
     auto is_down_this_frame(keyboard_key key) const -> bool;
+
+    auto serialise(auto& archive) -> void { archive(d_down, d_down_this_frame); }
 };
     
 }
\ No newline at end of file
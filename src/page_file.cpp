@@ -0,0 +1,105 @@
+#include "page_file.hpp"
+
+#include <cassert>
+#include <format>
+#include <print>
+#include <random>
+
+namespace sand {
+
+page_file::page_file(std::size_t num_chunks)
+    : d_extents(num_chunks)
+{
+    auto error = std::error_code{};
+    const auto directory = std::filesystem::temp_directory_path(error);
+    if (!error) {
+        auto device = std::random_device{};
+        const auto id = (std::uint64_t{device()} << 32) | device();
+        d_path = directory / std::format("sandfall-{:016x}.pages", id);
+        d_file.open(d_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    }
+    if (!d_file.is_open()) {
+        std::print("Could not create a page file, paged out chunks stay in memory\n");
+        d_in_memory.resize(num_chunks);
+    }
+}
+
+page_file::~page_file()
+{
+    if (d_file.is_open()) {
+        d_file.close();
+        auto error = std::error_code{};
+        std::filesystem::remove(d_path, error);
+    }
+}
+
+auto page_file::write(std::size_t chunk, std::span<const std::byte> block) -> void
+{
+    assert(!block.empty());
+    const auto lock = std::scoped_lock{d_mutex};
+    auto& e = d_extents[chunk];
+    if (e.size == 0) ++d_stored;
+    e.size = static_cast<std::uint32_t>(block.size());
+
+    if (!d_file.is_open()) {
+        d_in_memory[chunk].assign(block.begin(), block.end());
+        return;
+    }
+    if (e.capacity < e.size) {
+        e.offset = d_end;
+        e.capacity = e.size;
+        d_end += e.size;
+    }
+    d_file.seekp(static_cast<std::streamoff>(e.offset));
+    d_file.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(block.size()));
+}
+
+auto page_file::read(std::size_t chunk) const -> std::vector<std::byte>
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    const auto& e = d_extents[chunk];
+    if (!d_file.is_open()) return d_in_memory[chunk];
+
+    auto block = std::vector<std::byte>(e.size);
+    d_file.seekg(static_cast<std::streamoff>(e.offset));
+    d_file.read(reinterpret_cast<char*>(block.data()), static_cast<std::streamsize>(block.size()));
+    if (!d_file) {
+        std::print("Could not read chunk {} from the page file\n", chunk);
+        d_file.clear();
+        return {};
+    }
+    return block;
+}
+
+auto page_file::erase(std::size_t chunk) -> void
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    auto& e = d_extents[chunk];
+    if (e.size == 0) return;
+    e.size = 0; // The capacity stays with the chunk for its next block
+    --d_stored;
+    if (!d_file.is_open()) {
+        d_in_memory[chunk] = {};
+    }
+}
+
+auto page_file::clear() -> void
+{
+    for (std::size_t chunk = 0; chunk != d_extents.size(); ++chunk) {
+        erase(chunk);
+    }
+}
+
+auto page_file::contains(std::size_t chunk) const -> bool
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    return d_extents[chunk].size != 0;
+}
+
+auto page_file::size() const -> std::size_t
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    return d_stored;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace sand {
+
+// Holds the encoded blocks of paged out chunks in a temporary file, so a paged out chunk
+// costs only its extent in memory. A chunk's next block reuses its extent if it fits, and
+// otherwise goes on the end, so the file never holds more than the largest block of each
+// chunk. If the file cannot be made the blocks are kept in memory instead. The file is
+// removed when the page_file is destroyed. Reading a block that can't be read gives an
+// empty one.
+class page_file
+{
+    struct extent
+    {
+        std::uint64_t offset   = 0;
+        std::uint32_t size     = 0; // Zero when the chunk has no block stored
+        std::uint32_t capacity = 0;
+    };
+
+    std::filesystem::path d_path;
+    mutable std::fstream  d_file; // Reading moves its position
+    std::vector<extent>   d_extents; // By chunk
+    std::uint64_t         d_end    = 0;
+    std::size_t           d_stored = 0;
+
+    std::vector<std::vector<std::byte>> d_in_memory; // By chunk, only without a file
+
+    // Chunks are paged in from several workers at once but the stream has one position
+    mutable std::mutex d_mutex;
+
+    page_file(const page_file&) = delete;
+    page_file& operator=(const page_file&) = delete;
+
+public:
+    explicit page_file(std::size_t num_chunks);
+    ~page_file();
+
+    auto write(std::size_t chunk, std::span<const std::byte> block) -> void;
+    auto read(std::size_t chunk) const -> std::vector<std::byte>;
+    auto erase(std::size_t chunk) -> void;
+    auto clear() -> void;
+
+    auto contains(std::size_t chunk) const -> bool;
+    auto size() const -> std::size_t;
+};
+
+}
@@ -0,0 +1,59 @@
+#include "paging.hpp"
+#include "world.hpp"
+#include "config.hpp"
+#include "thread_pool.hpp"
+#include "profiler.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtx/norm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace sand {
+namespace {
+
+// From the centre to the nearest pixel of the chunk
+auto distance_to_chunk(const world& w, std::size_t index, glm::vec2 centre) -> float
+{
+    const auto top_left = glm::vec2{config::chunk_size * get_chunk_pos(w, index)};
+    const auto nearest = glm::clamp(centre, top_left, top_left + float(config::chunk_size - 1));
+    return glm::length(centre - nearest);
+}
+
+// Chunks being scanned or ticked need their pixels, as do ones with circuitry since power
+// is stepped every tick. Ones still to be drawn may go, as they are drawn only once back
+// in view, which may be long after they are far from the player.
+auto can_page_out(const world& w, std::size_t index) -> bool
+{
+    const auto& c = w.chunks[index];
+    return c.dirty.empty()
+        && c.dirty_next.empty()
+        && !w.ticking.test(index)
+        && !w.pixels.bitboards(index).circuit.any();
+}
+
+}
+
+auto update_paging(world& w, thread_pool& pool, glm::vec2 centre) -> void
+{
+    const auto zone = profile_zone{"update_paging"};
+
+    auto to_page_in = std::vector<std::size_t>{};
+    for (std::size_t index = 0; index != w.chunks.size(); ++index) {
+        const auto distance = distance_to_chunk(w, index, centre);
+        if (w.pixels.is_paged_out(index)) {
+            if (distance < config::page_in_distance) {
+                to_page_in.push_back(index);
+            }
+        } else if (distance > config::page_out_distance && can_page_out(w, index)) {
+            w.pixels.page_out(index);
+        }
+    }
+
+    pool.parallel_for(to_page_in.size(), [&](std::size_t i) {
+        w.pixels.page_in(to_page_in[i]);
+    });
+}
+
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <glm/glm.hpp>
+
+namespace sand {
+
+struct world;
+class thread_pool;
+
+// Pages out the pixels of chunks that are far from the centre and have nothing happening
+// in them, and pages back in those that have come within range. Paging in is spread
+// across the pool so the update rarely has to fault a chunk in itself. Call between
+// updates, after the renderer has drawn what changed.
+auto update_paging(world& w, thread_pool& pool, glm::vec2 centre) -> void;
+
+}
@@ -1,8 +1,9 @@
 #include "pixel.hpp"
 #include "utility.hpp"
 
+#include <array>
 #include <cstdlib>
-#include <print>
+#include <utility>
 #include <vector>
 
 namespace sand {
@@ -18,38 +19,33 @@ auto light_noise() -> glm::vec4
     };
 }
 
-}
-
-auto properties(const pixel& pix) -> const pixel_properties&
+constexpr auto make_properties(pixel_type type) -> pixel_properties
 {
-    switch (pix.type) {
+    switch (type) {
         case pixel_type::none: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .phase = pixel_phase::gas,
                 .corrosion_resist = 1.0f
             };
-            return px;
         }
         case pixel_type::sand: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .can_move_diagonally = true,
                 .gravity_factor = 1.0f,
                 .inertial_resistance = 0.1f,
                 .corrosion_resist = 0.3f
             };
-            return px;
         }
         case pixel_type::dirt: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .can_move_diagonally = true,
                 .gravity_factor = 1.0f,
                 .inertial_resistance = 0.4f,
                 .corrosion_resist = 0.5f
             };
-            return px;
         }
         case pixel_type::coal: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .can_move_diagonally = true,
                 .gravity_factor = 1.0f,
                 .inertial_resistance = 0.95f,
@@ -59,20 +55,18 @@ auto properties(const pixel& pix) -> const pixel_properties&
                 .put_out = 0.02f,
                 .burn_out_chance = 0.005f
             };
-            return px;
         }
         case pixel_type::water: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .phase = pixel_phase::liquid,
                 .can_move_diagonally = true,
                 .gravity_factor = 1.0f,
                 .dispersion_rate = 5,
                 .corrosion_resist = 1.0f,
             };
-            return px;
         }
         case pixel_type::lava: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .phase = pixel_phase::liquid,
                 .can_move_diagonally = true,
                 .gravity_factor = 1.0f,
@@ -82,10 +76,9 @@ auto properties(const pixel& pix) -> const pixel_properties&
                 .is_burn_source = true,
                 .is_ember_source = true
             };
-            return px;
         }
         case pixel_type::acid: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .phase = pixel_phase::liquid,
                 .can_move_diagonally = true,
                 .gravity_factor = 1.0f,
@@ -93,44 +86,39 @@ auto properties(const pixel& pix) -> const pixel_properties&
                 .corrosion_resist = 1.0f,
                 .is_corrosion_source = true
             };
-            return px;
         }
         case pixel_type::rock: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .corrosion_resist = 0.95f,
             };
-            return px;
         }
         case pixel_type::titanium: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .corrosion_resist = 1.0f,
                 .power_type = pixel_power_type::conductor,
                 .power_max = 25
             };
-            return px;
         }
         case pixel_type::steam: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .phase = pixel_phase::gas,
                 .can_move_diagonally = true,
                 .gravity_factor = -1.0f,
                 .dispersion_rate = 9,
                 .corrosion_resist = 0.0f
             };
-            return px;
         }
         case pixel_type::fuse: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .corrosion_resist = 0.1f,
                 .flammability = 0.25f,
                 .put_out_surrounded = 0.0f,
                 .put_out = 0.0f,
                 .burn_out_chance = 0.1f
             };
-            return px;
         }
         case pixel_type::ember: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .phase = pixel_phase::gas,
                 .can_move_diagonally = true,
                 .gravity_factor = -1.0f,
@@ -141,10 +129,9 @@ auto properties(const pixel& pix) -> const pixel_properties&
                 .put_out = 0.0f,
                 .burn_out_chance = 0.2f
             };
-            return px;
         }
         case pixel_type::oil: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .phase = pixel_phase::liquid,
                 .can_move_diagonally = true,
                 .gravity_factor = 1.0f,
@@ -155,10 +142,9 @@ auto properties(const pixel& pix) -> const pixel_properties&
                 .put_out = 0.02f,
                 .burn_out_chance = 0.005f
             };
-            return px;
         }
         case pixel_type::gunpowder: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .can_move_diagonally = true,
                 .gravity_factor = 1.0f,
                 .inertial_resistance = 0.1f,
@@ -169,10 +155,9 @@ auto properties(const pixel& pix) -> const pixel_properties&
                 .burn_out_chance = 0.1f,
                 .explosion_chance = 0.001f
             };
-            return px;
         }
         case pixel_type::methane: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .phase = pixel_phase::gas,
                 .can_move_diagonally = true,
                 .gravity_factor = -1.0f,
@@ -183,19 +168,16 @@ auto properties(const pixel& pix) -> const pixel_properties&
                 .put_out = 0.0f,
                 .burn_out_chance = 0.1f
             };
-            return px;
         }
         case pixel_type::battery: {
-            static constexpr auto px = pixel_properties{
-                .always_awake = true,
+            return pixel_properties{
                 .corrosion_resist = 1.0f,
                 .power_type = pixel_power_type::source,
                 .power_max = 5
             };
-            return px;
         }
         case pixel_type::solder: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .can_move_diagonally = true,
                 .gravity_factor = 1.0f,
                 .inertial_resistance = 0.05f,
@@ -203,50 +185,80 @@ auto properties(const pixel& pix) -> const pixel_properties&
                 .power_type = pixel_power_type::conductor,
                 .power_max = 24
             };
-            return px;
         }
         case pixel_type::diode_in:
         case pixel_type::diode_out: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .corrosion_resist = 1.0f,
                 .power_type = pixel_power_type::conductor,
                 .power_max = 25
             };
-            return px;
         }
         case pixel_type::spark: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .always_awake = true,
                 .spontaneous_destroy = 0.3f,
                 .corrosion_resist = 0.1f,
                 .power_type = pixel_power_type::source,
                 .power_max = 100
             };
-            return px;
         }
         case pixel_type::c4: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .corrosion_resist = 0.95f,
                 .explodes_on_power = true,
                 .power_type = pixel_power_type::conductor,
                 .power_max = 10
             };
-            return px;
         }
         case pixel_type::relay: {
-            static constexpr auto px = pixel_properties{
+            return pixel_properties{
                 .corrosion_resist = 1.0f
             };
-            return px;
         }
         default: {
-            std::print("ERROR: Unknown pixel type {}\n", static_cast<int>(pix.type));
-            static constexpr auto px = pixel_properties{};
-            return px;
+            return pixel_properties{};
         }
     }
 }
 
+// The hot subset of a type, see pixel_hot_properties
+constexpr auto make_hot_properties(const pixel_properties& props) -> pixel_hot_properties
+{
+    auto traits = std::uint8_t{0};
+    if (props.can_move_diagonally) traits |= pixel_trait::moves_diagonally;
+    if (props.always_awake)        traits |= pixel_trait::always_awake;
+    if (props.is_burn_source)      traits |= pixel_trait::burn_source;
+    if (props.is_corrosion_source) traits |= pixel_trait::corrosion_source;
+    if (props.can_boil_water)      traits |= pixel_trait::boils_water;
+    if (props.is_ember_source)     traits |= pixel_trait::ember_source;
+    if (props.flammability > 0.0f) traits |= pixel_trait::flammable;
+    if (props.power_type != pixel_power_type::none) traits |= pixel_trait::powered;
+    return {
+        .gravity_factor = props.gravity_factor,
+        .phase = props.phase,
+        .traits = traits
+    };
+}
+
+}
+
+constinit const std::array<pixel_properties, num_pixel_types> property_table = [] {
+    auto table = std::array<pixel_properties, num_pixel_types>{};
+    for (std::size_t i = 0; i != num_pixel_types; ++i) {
+        table[i] = make_properties(static_cast<pixel_type>(i));
+    }
+    return table;
+}();
+
+constinit const std::array<pixel_hot_properties, num_pixel_types> hot_property_table = [] {
+    auto table = std::array<pixel_hot_properties, num_pixel_types>{};
+    for (std::size_t i = 0; i != num_pixel_types; ++i) {
+        table[i] = make_hot_properties(make_properties(static_cast<pixel_type>(i)));
+    }
+    return table;
+}();
+
 auto pixel::air() -> pixel
 {
     return pixel{
@@ -437,10 +449,33 @@ auto pixel::relay() -> pixel
     };
 }
 
-auto is_active_power_source(const pixel& px) -> bool
+auto pixel::of(pixel_type type) -> pixel
 {
-    const auto& props = properties(px);
-    return props.power_type == pixel_power_type::source && px.power == props.power_max;
+    switch (type) {
+        case pixel_type::none: return air();
+        case pixel_type::sand: return sand();
+        case pixel_type::dirt: return dirt();
+        case pixel_type::coal: return coal();
+        case pixel_type::water: return water();
+        case pixel_type::lava: return lava();
+        case pixel_type::acid: return acid();
+        case pixel_type::rock: return rock();
+        case pixel_type::titanium: return titanium();
+        case pixel_type::steam: return steam();
+        case pixel_type::fuse: return fuse();
+        case pixel_type::ember: return ember();
+        case pixel_type::oil: return oil();
+        case pixel_type::gunpowder: return gunpowder();
+        case pixel_type::methane: return methane();
+        case pixel_type::battery: return battery();
+        case pixel_type::solder: return solder();
+        case pixel_type::diode_in: return diode_in();
+        case pixel_type::diode_out: return diode_out();
+        case pixel_type::spark: return spark();
+        case pixel_type::c4: return c4();
+        case pixel_type::relay: return relay();
+    }
+    std::unreachable();
 }
 
 }
\ No newline at end of file
@@ -2,7 +2,10 @@
 #include <glm/glm.hpp>
 #include <box2d/box2d.h>
 
+#include <array>
 #include <bitset>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 
 namespace sand {
@@ -14,6 +17,8 @@ enum pixel_flags : std::size_t
     is_burning, // 2
 };
 
+static constexpr auto num_pixel_flags = std::size_t{3};
+
 enum class pixel_phase : std::uint8_t
 {
     solid,
@@ -124,14 +129,65 @@ struct pixel
     static auto spark() -> pixel;
     static auto c4() -> pixel;
     static auto relay() -> pixel;
+
+    // A new pixel of the given type, from the maker of the same name
+    static auto of(pixel_type type) -> pixel;
 };
 
-auto properties(const pixel& px) -> const pixel_properties&;
+static constexpr auto num_pixel_types = static_cast<std::size_t>(pixel_type::relay) + 1;
+
+enum pixel_trait : std::uint8_t
+{
+    moves_diagonally = 1 << 0,
+    always_awake     = 1 << 1,
+    burn_source      = 1 << 2,
+    corrosion_source = 1 << 3,
+    boils_water      = 1 << 4,
+    ember_source     = 1 << 5,
+    flammable        = 1 << 6,
+    powered          = 1 << 7,
+};
+
+// The handful of properties read for every pixel on every tick, packed so that the whole
+// table fits in a few cache lines. The traits are pixel_trait bits.
+struct pixel_hot_properties
+{
+    float        gravity_factor = 0.0f;
+    pixel_phase  phase          = pixel_phase::solid;
+    std::uint8_t traits         = 0;
+
+    auto has(pixel_trait trait) const -> bool { return traits & trait; }
+};
+
+// Both are indexed by pixel_type and built at compile time from the same definitions
+extern const std::array<pixel_properties, num_pixel_types>     property_table;
+extern const std::array<pixel_hot_properties, num_pixel_types> hot_property_table;
+
+inline auto properties(pixel_type type) -> const pixel_properties&
+{
+    assert(static_cast<std::size_t>(type) < num_pixel_types);
+    return property_table[static_cast<std::size_t>(type)];
+}
+
+inline auto properties(const pixel& px) -> const pixel_properties&
+{
+    return properties(px.type);
+}
+
+inline auto hot_properties(pixel_type type) -> const pixel_hot_properties&
+{
+    assert(static_cast<std::size_t>(type) < num_pixel_types);
+    return hot_property_table[static_cast<std::size_t>(type)];
+}
 
 auto serialise(auto& archive, pixel& px) -> void {
     archive(px.type, px.colour, px.velocity, px.flags, px.power);
 }
 
-auto is_active_power_source(const pixel& px) -> bool;
+// Pixels that make up circuits, relays carry no power themselves but pass it across
+inline auto is_circuit_pixel(pixel_type type) -> bool
+{
+    return hot_properties(type).has(pixel_trait::powered) || type == pixel_type::relay;
+}
 
 }
\ No newline at end of file
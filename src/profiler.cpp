@@ -0,0 +1,120 @@
+#include "profiler.hpp"
+
+#include <atomic>
+#include <format>
+#include <fstream>
+#include <iterator>
+
+namespace sand {
+namespace {
+
+auto thread_index() -> std::uint32_t
+{
+    static std::atomic<std::uint32_t> next = 0;
+    static thread_local const auto index = next++;
+    return index;
+}
+
+auto thread_depth() -> std::uint32_t&
+{
+    static thread_local auto depth = std::uint32_t{0};
+    return depth;
+}
+
+auto to_ms(std::chrono::steady_clock::duration d) -> double
+{
+    return std::chrono::duration<double, std::milli>{d}.count();
+}
+
+}
+
+profiler::profiler()
+    : d_epoch{clock::now()}
+    , d_frame_start{d_epoch}
+{}
+
+auto profiler::begin_frame() -> void
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    d_frame_start = clock::now();
+    d_in_frame = true;
+    auto& frame = d_frames[d_current];
+    frame.start_ms = to_ms(d_frame_start - d_epoch);
+    frame.zones.clear();
+}
+
+auto profiler::end_frame() -> void
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    d_frames[d_current].duration_ms = to_ms(clock::now() - d_frame_start);
+    d_in_frame = false;
+    d_current = (d_current + 1) % num_slots;
+    d_recorded = std::min(d_recorded + 1, num_frames);
+}
+
+auto profiler::record(const char* name, clock::time_point start, clock::time_point end, std::uint32_t depth) -> void
+{
+    const auto thread = thread_index();
+    const auto lock = std::scoped_lock{d_mutex};
+    if (!d_in_frame) return;
+    d_frames[d_current].zones.push_back({
+        .name = name,
+        .thread = thread,
+        .depth = depth,
+        .start_ms = to_ms(start - d_frame_start),
+        .duration_ms = to_ms(end - start)
+    });
+}
+
+auto profiler::frame(std::size_t index) const -> const profile_frame&
+{
+    const auto oldest = (d_current + num_slots - d_recorded) % num_slots;
+    return d_frames[(oldest + index) % num_slots];
+}
+
+auto profiler::export_chrome_trace(const std::filesystem::path& file) const -> bool
+{
+    auto out = std::ofstream{file};
+    if (!out) return false;
+
+    const auto lock = std::scoped_lock{d_mutex};
+    out << "{\"traceEvents\":[";
+    auto first = true;
+    for (std::size_t i = 0; i != d_recorded; ++i) {
+        const auto& f = frame(i);
+        const auto emit = [&](const char* name, std::uint32_t thread, double start_ms, double duration_ms) {
+            std::format_to(
+                std::ostreambuf_iterator{out},
+                "{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                first ? "" : ",", name, thread, 1000.0 * start_ms, 1000.0 * duration_ms
+            );
+            first = false;
+        };
+        emit("frame", 0, f.start_ms, f.duration_ms);
+        for (const auto& zone : f.zones) {
+            emit(zone.name, zone.thread, f.start_ms + zone.start_ms, zone.duration_ms);
+        }
+    }
+    out << "]}\n";
+    return static_cast<bool>(out);
+}
+
+auto get_profiler() -> profiler&
+{
+    static auto instance = profiler{};
+    return instance;
+}
+
+profile_zone::profile_zone(const char* name)
+    : d_name{name}
+    , d_start{std::chrono::steady_clock::now()}
+    , d_depth{thread_depth()++}
+{}
+
+profile_zone::~profile_zone()
+{
+    --thread_depth();
+    get_profiler().record(d_name, d_start, std::chrono::steady_clock::now(), d_depth);
+}
+
+}
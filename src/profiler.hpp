@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+namespace sand {
+
+struct profile_zone_record
+{
+    const char*   name;
+    std::uint32_t thread;      // Small per thread id, in the order threads first record
+    std::uint32_t depth;       // How many zones were open on the thread when this one began
+    double        start_ms;    // Relative to the start of the frame
+    double        duration_ms;
+};
+
+struct profile_frame
+{
+    double                           start_ms    = 0.0; // Relative to the profiler starting
+    double                           duration_ms = 0.0;
+    std::vector<profile_zone_record> zones;
+};
+
+// Collects timed zones from any thread into a ring buffer of recent frames. Zones are only
+// recorded between begin_frame and end_frame, so code that is also run headless can be
+// instrumented without the records piling up.
+class profiler
+{
+public:
+    static constexpr std::size_t num_frames = 300;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    // One more than is kept, so the frame being recorded, which other threads are adding to,
+    // is never one of the completed frames
+    static constexpr std::size_t num_slots = num_frames + 1;
+
+    std::array<profile_frame, num_slots> d_frames;
+    std::size_t       d_current  = 0; // The frame being recorded
+    std::size_t       d_recorded = 0; // The number of completed frames, up to num_frames
+    clock::time_point d_epoch;
+    clock::time_point d_frame_start;
+    bool              d_in_frame = false;
+    mutable std::mutex d_mutex;
+
+public:
+    profiler();
+
+    auto begin_frame() -> void;
+    auto end_frame() -> void;
+
+    auto record(const char* name, clock::time_point start, clock::time_point end, std::uint32_t depth) -> void;
+
+    // Completed frames, index 0 being the oldest. Only call these from the thread that
+    // begins and ends frames.
+    auto num_recorded() const -> std::size_t { return d_recorded; }
+    auto frame(std::size_t index) const -> const profile_frame&;
+
+    // Writes the recorded frames in the Chrome trace event format, which can be opened
+    // in chrome://tracing or Perfetto. Returns false if the file could not be written.
+    auto export_chrome_trace(const std::filesystem::path& file) const -> bool;
+};
+
+auto get_profiler() -> profiler&;
+
+// Times the enclosing scope. The name must outlive the profiler, so use string literals.
+class profile_zone
+{
+    const char*                           d_name;
+    std::chrono::steady_clock::time_point d_start;
+    std::uint32_t                         d_depth;
+
+    profile_zone(const profile_zone&) = delete;
+    profile_zone& operator=(const profile_zone&) = delete;
+
+public:
+    explicit profile_zone(const char* name);
+    ~profile_zone();
+};
+
+}
@@ -0,0 +1,144 @@
+#include "replay.hpp"
+#include "world_save.hpp"
+#include "update.hpp"
+#include "update_rigid_bodies.hpp"
+#include "utility.hpp"
+#include "thread_pool.hpp"
+
+#include <cereal/cereal.hpp>
+#include <cereal/archives/binary.hpp>
+
+#include <bit>
+#include <cassert>
+#include <fstream>
+#include <utility>
+
+namespace sand {
+
+namespace {
+
+// Explosions and the pixel makers use the generator, so in deterministic mode each edit in
+// a tick gets a stream of its own after the ones update uses
+auto seed_edit(world& w) -> void
+{
+    if (w.edit_tick != w.tick) {
+        w.edit_tick = w.tick;
+        w.edit_count = 0;
+    }
+    const auto stream = w.chunks.size() + 1 + w.edit_count++;
+    if (w.seed) {
+        random_seed(*w.seed ^ std::rotl(w.tick, 32) ^ stream);
+    }
+}
+
+}
+
+auto apply_edit(world& w, const world_edit& edit) -> void
+{
+    seed_edit(w);
+    std::visit(overloaded{
+        [&](const paint_edit& paint) {
+            for (const auto& [pos, px] : paint.pixels) {
+                if (w.pixels.valid(pos)) {
+                    w.pixels[pos] = px;
+                    w.wake_chunk_with_pixel(pos);
+                }
+            }
+        },
+        [&](const explosion_edit& blast) {
+            apply_explosion(w, blast.centre, blast.blast);
+        },
+        [&](const rect_edit& rect) {
+            w.fill_rect(rect.min, rect.max, [&] { return pixel::of(rect.type); });
+        },
+        [&](const circle_edit& circle) {
+            w.fill_circle(circle.centre, circle.radius, [&] { return pixel::of(circle.type); });
+        },
+        [&](const collider_mode_edit& mode) {
+            w.colliders = mode.mode;
+            rebuild_colliders(w);
+        },
+        [&](const level_liquids_edit& level) {
+            w.level_liquids = level.enabled;
+        },
+        [&](const spawn_edit& spawn) {
+            w.spawn_point = spawn.spawn_point;
+            if (spawn.respawn) {
+                w.player.set_position(w.spawn_point);
+            }
+        },
+        [&](const clear_edit&) {
+            w.wake_all();
+            w.pixels.fill(pixel::air());
+        }
+    }, edit);
+}
+
+auto hash_pixels(const world& w) -> std::uint64_t
+{
+    auto hash = std::uint64_t{0};
+    for (std::size_t index = 0; index != w.chunks.size(); ++index) {
+        hash = hash_word(hash, w.pixels.hash_chunk(index));
+    }
+    return hash;
+}
+
+auto begin_replay(std::unique_ptr<world>& w, std::uint64_t seed, thread_pool& pool) -> replay
+{
+    auto r = replay{
+        .initial = encode_world(*w),
+        .player_position = glm::ivec2{w->player.centre()},
+        .seed = seed,
+        .colliders = w->colliders,
+        .level_liquids = w->level_liquids
+    };
+    auto fresh = replay_world(r, pool);
+    assert(fresh);
+    w = std::move(fresh);
+    return r;
+}
+
+auto replay_world(const replay& r, thread_pool& pool) -> std::unique_ptr<world>
+{
+    auto w = decode_world(r.initial, pool);
+    if (!w) return nullptr;
+    w->seed = r.seed;
+    w->colliders = r.colliders;
+    w->level_liquids = r.level_liquids;
+    w->player.set_position(r.player_position);
+    return w;
+}
+
+auto replay_tick_world(world& w, const replay_tick& tick, thread_pool& pool) -> void
+{
+    for (const auto& edit : tick.edits) {
+        apply_edit(w, edit);
+    }
+    update(w, pool);
+    w.player.update(tick.input);
+}
+
+auto save_replay(const std::string& file_path, const replay& r) -> void
+{
+    auto file = std::ofstream{file_path, std::ios::binary};
+    auto archive = cereal::BinaryOutputArchive{file};
+    archive(r);
+}
+
+auto load_replay(const std::string& file_path) -> std::optional<replay>
+{
+    auto file = std::ifstream{file_path, std::ios::binary};
+    if (!file) return std::nullopt;
+
+    // The archive throws when the file runs out part way through a field
+    auto archive = cereal::BinaryInputArchive{file};
+    auto r = replay{};
+    try {
+        archive(r);
+    } catch (const cereal::Exception&) {
+        return std::nullopt;
+    }
+    return r;
+}
+
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include "world.hpp"
+#include "pixel.hpp"
+#include "explosion.hpp"
+#include "mouse.hpp"
+#include "serialise.hpp"
+
+#include <glm/glm.hpp>
+#include <cereal/types/variant.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace sand {
+
+class thread_pool;
+
+// Edits made to the world from the frontend. They are kept as data rather than posted as
+// arbitrary commands so that they can be recorded and played back.
+struct painted_pixel
+{
+    glm::ivec2 pos;
+    pixel      px;
+
+    auto serialise(auto& archive) -> void { archive(pos, px); }
+};
+
+struct paint_edit
+{
+    std::vector<painted_pixel> pixels; // Each is written and its chunk woken
+
+    auto serialise(auto& archive) -> void { archive(pixels); }
+};
+
+struct explosion_edit
+{
+    glm::vec2 centre;
+    explosion blast;
+
+    auto serialise(auto& archive) -> void
+    {
+        archive(centre, blast.min_radius, blast.max_radius, blast.scorch);
+    }
+};
+
+// Filled with new pixels of the type, so only the type needs recording
+struct rect_edit
+{
+    glm::ivec2 min;
+    glm::ivec2 max;
+    pixel_type type;
+
+    auto serialise(auto& archive) -> void { archive(min, max, type); }
+};
+
+struct circle_edit
+{
+    glm::ivec2 centre;
+    float      radius;
+    pixel_type type;
+
+    auto serialise(auto& archive) -> void { archive(centre, radius, type); }
+};
+
+// Changes to the world's settings from the editor, which change what the following ticks
+// do and so are recorded like any other edit
+struct collider_mode_edit
+{
+    collider_mode mode; // Every collider is rebuilt in it
+
+    auto serialise(auto& archive) -> void { archive(mode); }
+};
+
+struct level_liquids_edit
+{
+    bool enabled;
+
+    auto serialise(auto& archive) -> void { archive(enabled); }
+};
+
+struct spawn_edit
+{
+    glm::ivec2 spawn_point;
+    bool       respawn; // Also moves the player there
+
+    auto serialise(auto& archive) -> void { archive(spawn_point, respawn); }
+};
+
+// Every pixel is replaced with air
+struct clear_edit
+{
+    auto serialise(auto&) -> void {}
+};
+
+// New alternatives go on the end, since the index is what recordings store
+using world_edit = std::variant<
+    paint_edit, explosion_edit, rect_edit, circle_edit,
+    collider_mode_edit, level_liquids_edit, spawn_edit, clear_edit
+>;
+
+auto apply_edit(world& w, const world_edit& edit) -> void;
+
+// One tick of a recording, in the order they happen in simulation::tick
+struct replay_tick
+{
+    std::vector<world_edit> edits; // Applied before the update
+    keyboard                input; // Given to the player after it
+    std::uint64_t           hash;  // Of the pixels at the end of the tick
+
+    auto serialise(auto& archive) -> void { archive(edits, input, hash); }
+};
+
+// A run of the simulation that can be played back exactly, from the world as it was when
+// recording began. Only the edits and the player's input are recorded, so anything else
+// done to the world while recording, such as loading a level, ends the recording.
+struct replay
+{
+    std::vector<std::byte>   initial; // In the save format
+    glm::ivec2               player_position;
+    std::uint64_t            seed;
+    collider_mode            colliders;
+    bool                     level_liquids;
+    std::vector<replay_tick> ticks;
+
+    auto serialise(auto& archive) -> void
+    {
+        archive(initial, player_position, seed, colliders, level_liquids, ticks);
+    }
+};
+
+// Hashes the pixels of every chunk, to be compared between runs after the same tick
+auto hash_pixels(const world& w) -> std::uint64_t;
+
+// Starts a recording of the given world, which is replaced by the world the replay starts
+// from. The two hold the same pixels but only a freshly loaded world is guaranteed to have
+// the same chunk, physics and player state as the one built again when playing back.
+auto begin_replay(std::unique_ptr<world>& w, std::uint64_t seed, thread_pool& pool) -> replay;
+
+// The world a replay starts from, nullptr if its initial save is corrupt
+auto replay_world(const replay& r, thread_pool& pool) -> std::unique_ptr<world>;
+
+// The world is stepped exactly as the simulation steps it during recording
+auto replay_tick_world(world& w, const replay_tick& tick, thread_pool& pool) -> void;
+
+auto save_replay(const std::string& file_path, const replay& r) -> void;
+auto load_replay(const std::string& file_path) -> std::optional<replay>; // Empty if missing or corrupt
+
+}
@@ -9,7 +9,10 @@
 #include "explosion.hpp"
 #include "mouse.hpp"
 #include "player.hpp"
-#include "world_save.hpp"
+#include "simulation.hpp"
+#include "snapshot.hpp"
+#include "replay.hpp"
+#include "profiler.hpp"
 
 #include "graphics/renderer.hpp"
 #include "graphics/shape_renderer.hpp"
@@ -20,60 +23,138 @@
 #include <glm/gtx/norm.hpp>
 #include <imgui/imgui.h>
 #include <box2d/box2d.h>
-#include <cereal/archives/binary.hpp>
 
+#include <format>
+#include <functional>
+#include <map>
 #include <memory>
+#include <optional>
 #include <print>
-#include <fstream>
 #include <cmath>
 #include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
-auto render_body_triangles(sand::shape_renderer& rend, const b2Body* body) -> void
+auto mouse_pos_world_space(const sand::window& w, const sand::camera& c) -> glm::vec2
 {
-    if (!body) return;
-    for (auto fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext()) {
-        if (fixture->GetShape()->GetType() == b2Shape::Type::e_polygon) {
-            const auto* shape = static_cast<const b2PolygonShape*>(fixture->GetShape());
-            if (shape->m_count == 3) {
-                const auto p1 = sand::physics_to_pixel(shape->m_vertices[0]);
-                const auto p2 = sand::physics_to_pixel(shape->m_vertices[1]);
-                const auto p3 = sand::physics_to_pixel(shape->m_vertices[2]);
-                rend.draw_line(p1, p2, {1,0,0,1}, 1);
-                rend.draw_line(p2, p3, {1,0,0,1}, 1);
-                rend.draw_line(p3, p1, {1,0,0,1}, 1);
-            }
-        }
+    return w.get_mouse_pos() / c.world_to_screen + c.top_left;
+}
+
+auto pixel_at_mouse(const sand::window& w, const sand::camera& c) -> glm::ivec2
+{
+    return glm::ivec2{mouse_pos_world_space(w, c)};
+}
+
+constexpr const char* heatmap_metrics[] = {
+    "Pixels updated", "Moves", "Wakes", "Random draws", "Collider ms", "Fixtures"
+};
+
+auto heatmap_value(const sand::chunk_stats& stats, int metric) -> float
+{
+    switch (metric) {
+        case 0: return static_cast<float>(stats.pixels);
+        case 1: return static_cast<float>(stats.moves);
+        case 2: return static_cast<float>(stats.wakes);
+        case 3: return static_cast<float>(stats.random_draws);
+        case 4: return stats.collider_ms;
+        case 5: return static_cast<float>(stats.fixtures);
+        default: return 0.0f;
     }
 }
 
-auto save_world(const std::string& file_path, const sand::world& w) -> void
+auto chunk_stats_text(const sand::chunk_stats& stats) -> std::string
 {
-    auto file = std::ofstream{file_path, std::ios::binary};
-    auto archive = cereal::BinaryOutputArchive{file};
-
-    auto save = sand::world_save{
-        .pixels = w.pixels.data(),
-        .width = w.pixels.width(),
-        .height = w.pixels.height(),
-        .spawn_point = w.spawn_point
-    };
+    return std::format(
+        "Pixels updated: {}\nMoves: {}\nWakes: {}\nRandom draws: {}\nCollider: {:.3f} ms\nFixtures: {}",
+        stats.pixels, stats.moves, stats.wakes, stats.random_draws, stats.collider_ms, stats.fixtures
+    );
+}
 
-    archive(save);
+// The first and last chunk at least partly on screen in each direction
+auto visible_chunks(const sand::camera& c) -> std::pair<glm::ivec2, glm::ivec2>
+{
+    const auto bottom_right = c.top_left + glm::vec2{c.screen_width, c.screen_height} / c.world_to_screen;
+    return {
+        glm::ivec2{glm::floor(c.top_left / float(sand::config::chunk_size))},
+        glm::ivec2{glm::floor(bottom_right / float(sand::config::chunk_size))}
+    };
 }
 
-auto load_world(const std::string& file_path) -> std::unique_ptr<sand::world>
+// Shows the time spent in each zone over the recorded frames, and a flame graph of the
+// zones in the latest frame with a row per thread and nesting depth
+auto draw_profiler_window(const sand::profiler& profiler) -> void
 {
-    auto file = std::ifstream{file_path, std::ios::binary};
-    auto archive = cereal::BinaryInputArchive{file};
+    if (!ImGui::Begin("Profiler")) {
+        ImGui::End();
+        return;
+    }
+
+    const auto num_frames = profiler.num_recorded();
+    if (num_frames == 0) {
+        ImGui::Text("No frames recorded");
+        ImGui::End();
+        return;
+    }
+
+    auto frame_times = std::vector<float>(num_frames);
+    auto stage_times = std::map<std::string_view, std::vector<float>>{};
+    for (std::size_t i = 0; i != num_frames; ++i) {
+        const auto& frame = profiler.frame(i);
+        frame_times[i] = static_cast<float>(frame.duration_ms);
+        for (const auto& zone : frame.zones) {
+            auto& times = stage_times[zone.name];
+            times.resize(num_frames);
+            times[i] += static_cast<float>(zone.duration_ms);
+        }
+    }
 
-    auto save = sand::world_save{};
-    archive(save);
+    const auto& latest = profiler.frame(num_frames - 1);
+    ImGui::Text("Frame: %.2f ms", latest.duration_ms);
+    ImGui::PlotHistogram("##frames", frame_times.data(), (int)frame_times.size(), 0, "frame ms", 0.0f, 33.3f, {0, 60});
+
+    ImGui::Separator();
+    for (const auto& [name, times] : stage_times) {
+        const auto label = std::string{name};
+        const auto overlay = std::format("{:.2f} ms", times.back());
+        ImGui::PlotLines(label.c_str(), times.data(), (int)times.size(), 0, overlay.c_str(), 0.0f, 16.6f, {0, 30});
+    }
+
+    ImGui::Separator();
+    static constexpr auto row_height = 18.0f;
+    const auto origin = ImGui::GetCursorScreenPos();
+    const auto width = ImGui::GetContentRegionAvail().x;
+    const auto scale = width / static_cast<float>(std::max(latest.duration_ms, 0.001));
+    auto rows = std::uint32_t{0};
+    for (const auto& zone : latest.zones) {
+        rows = std::max(rows, 4 * zone.thread + zone.depth + 1);
+    }
 
-    auto w = std::make_unique<sand::world>(save.width, save.height);
-    w->pixels = {save.width, save.height, save.pixels};
-    w->spawn_point = save.spawn_point;
-    w->player.set_position(save.spawn_point);
-    return w;
+    auto* draw_list = ImGui::GetWindowDrawList();
+    for (const auto& zone : latest.zones) {
+        const auto row = static_cast<float>(4 * zone.thread + zone.depth);
+        const auto min = ImVec2{origin.x + scale * (float)zone.start_ms, origin.y + row * row_height};
+        const auto max = ImVec2{min.x + std::max(1.0f, scale * (float)zone.duration_ms), min.y + row_height - 1};
+        const auto hue = static_cast<ImU32>(std::hash<std::string_view>{}(zone.name));
+        draw_list->AddRectFilled(min, max, IM_COL32(80 + hue % 120, 80 + (hue >> 8) % 120, 160, 255));
+        draw_list->PushClipRect(min, max, true);
+        draw_list->AddText({min.x + 2, min.y + 2}, IM_COL32(255, 255, 255, 255), zone.name);
+        draw_list->PopClipRect();
+        if (ImGui::IsMouseHoveringRect(min, max)) {
+            ImGui::SetTooltip("%s\n%.3f ms (thread %u)", zone.name, zone.duration_ms, zone.thread);
+        }
+    }
+    ImGui::Dummy({width, rows * row_height});
+
+    ImGui::Separator();
+    if (ImGui::Button("Export Chrome Trace")) {
+        const auto ok = profiler.export_chrome_trace("trace.json");
+        std::print("{} trace.json\n", ok ? "Wrote" : "Failed to write");
+    }
+
+    ImGui::End();
 }
 
 auto new_world(int chunks_width, int chunks_height) -> std::unique_ptr<sand::world>
@@ -130,19 +211,27 @@ auto main() -> int
         }
     });
 
-    auto world           = std::make_unique<sand::world>(256, 256);
-    auto world_renderer  = sand::renderer{world->pixels.width(), world->pixels.height()};
+    auto simulation      = sand::simulation{std::make_unique<sand::world>(256, 256), static_cast<std::size_t>(editor.num_threads)};
+    auto world_renderer  = sand::renderer{256, 256};
     auto ui              = sand::ui{window};
-    auto accumulator     = 0.0;
     auto timer           = sand::timer{};
     auto shape_renderer  = sand::shape_renderer{};
     auto show_triangles = false;
+    auto drawn_outlines = std::vector<std::shared_ptr<const sand::collider_outline>>{};
+    const auto no_outlines = decltype(drawn_outlines){};
     auto show_spawn     = false;
+    auto threaded       = false;
 
     auto new_world_chunks_width  = 4;
     auto new_world_chunks_height = 4;
 
+    // The latest snapshot drawn, which everything below reads instead of the world
+    auto snapshot = std::unique_ptr<sand::world_snapshot>{};
+
+    auto& profiler = sand::get_profiler();
+
     while (window.is_running()) {
+        profiler.begin_frame();
         const double dt = timer.on_update();
 
         mouse.on_new_frame();
@@ -151,49 +240,58 @@ auto main() -> int
         window.poll_events();
         window.clear();
 
-        accumulator += dt;
-        bool updated = false;
-        while (accumulator > sand::config::time_step) {
-            accumulator -= sand::config::time_step;
-            updated = true;
-            sand::update(*world);
-            world->player.update(keyboard);
-        }
-
+        simulation.set_input(keyboard);
+        const auto [view_min, view_max] = visible_chunks(camera);
+        simulation.set_snapshot_options({
+            .everything = world_renderer.needs_everything(editor.gpu_colouring),
+            .scanned = editor.show_chunks,
+            .colliders = show_triangles,
+            .telemetry = editor.show_heatmap,
+            .view_min = view_min,
+            .view_max = view_max
+        });
+        simulation.advance(dt);
+
+        // Edits are posted to the simulation and land before its next tick
         const auto mouse_pos = pixel_at_mouse(window, camera);
         switch (editor.brush_type) {
             break; case 0:
                 if (mouse.is_down(sand::mouse_button::left)) {
                     const auto coord = mouse_pos + sand::random_from_circle(editor.brush_size);
-                    if (world->pixels.valid(coord)) {
-                        world->pixels[coord] = editor.get_pixel();
-                        world->wake_chunk_with_pixel(coord);
-                        updated = true;
-                    }
+                    simulation.edit(sand::paint_edit{{{coord, editor.get_pixel()}}});
                 }
             break; case 1:
                 if (mouse.is_down(sand::mouse_button::left)) {
                     const auto half_extent = (int)(editor.brush_size / 2);
-                    for (int x = mouse_pos.x - half_extent; x != mouse_pos.x + half_extent + 1; ++x) {
-                        for (int y = mouse_pos.y - half_extent; y != mouse_pos.y + half_extent + 1; ++y) {
-                            if (world->pixels.valid({x, y})) {
-                                world->pixels[{x, y}] = editor.get_pixel();
-                                world->wake_chunk_with_pixel({x, y});
-                                updated = true;
-                            }
-                        }
-                    }
+                    simulation.edit(sand::rect_edit{
+                        mouse_pos - half_extent, mouse_pos + half_extent, editor.get_pixel().type
+                    });
                 }
             break; case 2:
                 if (mouse.is_down_this_frame(sand::mouse_button::left)) {
-                    sand::apply_explosion(*world, mouse_pos, sand::explosion{
+                    simulation.edit(sand::explosion_edit{mouse_pos, sand::explosion{
                         .min_radius = 40.0f, .max_radius = 45.0f, .scorch = 10.0f
-                    });
-                    updated = true;
+                    }});
                 }
+            break; case 3:
+                if (mouse.is_down(sand::mouse_button::left)) {
+                    simulation.edit(sand::circle_edit{mouse_pos, editor.brush_size, editor.get_pixel().type});
+                }
+        }
+
+        if (auto latest = simulation.take_snapshot()) {
+            snapshot = std::move(latest);
+            world_renderer.bind();
+            world_renderer.update(*snapshot, editor.gpu_colouring, camera);
+        }
+        if (!snapshot) {
+            window.swap_buffers();
+            profiler.end_frame();
+            continue;
         }
         
         // Renders the UI but doesn't yet draw on the screen
+        auto imgui_zone = std::optional<sand::profile_zone>{"ImGui"};
         ui.begin_frame();
         const auto mouse_actual = mouse_pos_world_space(window, camera);
         const auto mouse = pixel_at_mouse(window, camera);
@@ -215,23 +313,76 @@ auto main() -> int
 
             ImGui::Separator();
             ImGui::Checkbox("Show Triangles", &show_triangles);
+            const char* collider_modes[] = {"Triangles", "Convex", "Chain"};
+            auto mode = static_cast<int>(snapshot->colliders);
+            if (ImGui::Combo("Colliders", &mode, collider_modes, static_cast<int>(std::size(collider_modes)))) {
+                simulation.edit(sand::collider_mode_edit{static_cast<sand::collider_mode>(mode)});
+            }
+            ImGui::Text("Fixtures: %d, proxies: %d", snapshot->num_fixtures, snapshot->num_proxies);
+            ImGui::Text("Enabled chunk bodies: %zu", snapshot->enabled_chunk_bodies);
+            auto level_liquids = snapshot->level_liquids;
+            if (ImGui::Checkbox("Level Liquids", &level_liquids)) {
+                simulation.edit(sand::level_liquids_edit{level_liquids});
+            }
             ImGui::Checkbox("Show Spawn", &show_spawn);
-            ImGui::SliderInt("Spawn X", &world->spawn_point.x, 0, world->pixels.width());
-            ImGui::SliderInt("Spawn Y", &world->spawn_point.y, 0, world->pixels.height());
+            auto spawn_point = snapshot->spawn_point;
+            const auto spawn_x = ImGui::SliderInt("Spawn X", &spawn_point.x, 0, snapshot->width);
+            const auto spawn_y = ImGui::SliderInt("Spawn Y", &spawn_point.y, 0, snapshot->height);
+            if (spawn_x || spawn_y) {
+                simulation.edit(sand::spawn_edit{spawn_point, false});
+            }
             if (ImGui::Button("Respawn")) {
-                world->player.set_position(world->spawn_point);
+                simulation.edit(sand::spawn_edit{spawn_point, true});
             }
             ImGui::Separator();
 
             ImGui::Text("Info");
-            ImGui::Text("FPS: %d", timer.frame_rate());
-            ImGui::Text("Awake chunks: %d", std::count_if(world->chunks.begin(), world->chunks.end(), [](const sand::chunk& c) {
-                return c.should_step;
-            }));
+            ImGui::Text("FPS: %d, tick: %llu", timer.frame_rate(), static_cast<unsigned long long>(snapshot->tick));
+            ImGui::Text("Awake chunks: %zu", snapshot->awake_chunks);
+            ImGui::Text("Resident pages: %zu, paged out: %zu", snapshot->resident_pages, snapshot->paged_out);
             ImGui::Checkbox("Show chunks", &editor.show_chunks);
+            ImGui::Checkbox("GPU colouring", &editor.gpu_colouring);
+            ImGui::Checkbox("Show heatmap", &editor.show_heatmap);
+            if (editor.show_heatmap) {
+                ImGui::Combo("Metric", &editor.heatmap_metric, heatmap_metrics, static_cast<int>(std::size(heatmap_metrics)));
+
+                // The telemetry is from the snapshot before the one the option was set in
+                const auto chunk = glm::ivec2{glm::floor(mouse_actual / float(sand::config::chunk_size))};
+                const auto chunks_w = static_cast<int>(snapshot->width / sand::config::chunk_size);
+                const auto chunks_h = static_cast<int>(snapshot->height / sand::config::chunk_size);
+                const auto index = static_cast<std::size_t>(chunk.x + chunks_w * chunk.y);
+                if (0 <= chunk.x && chunk.x < chunks_w && 0 <= chunk.y && chunk.y < chunks_h && index < snapshot->telemetry.size()) {
+                    const auto text = chunk_stats_text(snapshot->telemetry[index]);
+                    ImGui::Text("Chunk {%d, %d}", chunk.x, chunk.y);
+                    ImGui::TextUnformatted(text.c_str());
+                    if (!ImGui::GetIO().WantCaptureMouse) {
+                        ImGui::SetTooltip("Chunk {%d, %d}\n%s", chunk.x, chunk.y, text.c_str());
+                    }
+                }
+            }
+            if (ImGui::Checkbox("Simulation thread", &threaded)) {
+                simulation.set_threaded(threaded);
+            }
+            const auto max_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            if (ImGui::SliderInt("Threads", &editor.num_threads, 1, max_threads)) {
+                simulation.set_num_threads(editor.num_threads);
+            }
+            auto deterministic = snapshot->deterministic;
+            if (ImGui::Checkbox("Deterministic", &deterministic)) {
+                simulation.post([deterministic](sand::world& w) {
+                    w.seed = deterministic ? std::optional<std::uint64_t>{0} : std::nullopt;
+                });
+            }
+            if (snapshot->recorded_ticks) {
+                ImGui::Text("Recording: %zu ticks", *snapshot->recorded_ticks);
+                if (ImGui::Button("Stop recording")) {
+                    simulation.stop_recording("replay.bin");
+                }
+            } else if (ImGui::Button("Record")) {
+                simulation.start_recording(0);
+            }
             if (ImGui::Button("Clear")) {
-                for (auto& c : world->chunks) { c.should_step_next = true; }
-                std::fill(world->pixels.begin(), world->pixels.end(), sand::pixel::air());
+                simulation.edit(sand::clear_edit{});
             }
             ImGui::Separator();
 
@@ -240,6 +391,7 @@ auto main() -> int
             if (ImGui::RadioButton("Spray", editor.brush_type == 0)) editor.brush_type = 0;
             if (ImGui::RadioButton("Square", editor.brush_type == 1)) editor.brush_type = 1;
             if (ImGui::RadioButton("Explosion", editor.brush_type == 2)) editor.brush_type = 2;
+            if (ImGui::RadioButton("Circle", editor.brush_type == 3)) editor.brush_type = 3;
 
             for (std::size_t i = 0; i != editor.pixel_makers.size(); ++i) {
                 if (ImGui::Selectable(editor.pixel_makers[i].first.c_str(), editor.current == i)) {
@@ -250,20 +402,18 @@ auto main() -> int
             ImGui::InputInt("chunk width", &new_world_chunks_width);
             ImGui::InputInt("chunk height", &new_world_chunks_height);
             if (ImGui::Button("New World")) {
-                world = new_world(new_world_chunks_width, new_world_chunks_height);
-                updated = true;
+                simulation.replace_world(new_world(new_world_chunks_width, new_world_chunks_height));
             }
             ImGui::Text("Levels");
             for (int i = 0; i != 5; ++i) {
                 ImGui::PushID(i);
                 const auto filename = std::format("save{}.bin", i);
                 if (ImGui::Button("Save")) {
-                    save_world(filename, *world);
+                    simulation.save(filename);
                 }
                 ImGui::SameLine();
                 if (ImGui::Button("Load")) {
-                    world = load_world(filename);
-                    updated = true;
+                    simulation.load(filename);
                 }
                 ImGui::SameLine();
                 ImGui::Text("Save %d", i);
@@ -272,33 +422,73 @@ auto main() -> int
         }
         ImGui::End();
 
-        // Render and display the world
+        draw_profiler_window(profiler);
+        imgui_zone.reset();
+
+        // Display the world as of the latest snapshot
         world_renderer.bind();
-        if (updated) {
-            world_renderer.update(*world, editor.show_chunks, camera);
-        }
         world_renderer.draw();
 
+        // The collider overlay stays on the GPU and is only rebuilt when an outline changes
+        const auto& outlines = show_triangles ? snapshot->collider_outlines : no_outlines;
+        if (outlines != drawn_outlines) {
+            auto lines = std::vector<sand::line_instance>{};
+            for (const auto& outline : outlines) {
+                if (!outline) continue;
+                for (const auto& [p1, p2] : *outline) {
+                    lines.push_back({p1, p2, {1,0,0,1}, {1,0,0,1}, 1});
+                }
+            }
+            shape_renderer.set_cached_lines(lines);
+            drawn_outlines = outlines;
+        }
+
         shape_renderer.begin_frame(camera);
 
-        shape_renderer.draw_circle(world->player.centre(), {1.0, 1.0, 0.0, 1.0}, world->player.radius());
+        // Each chunk is shaded from blue to red by its share of the costliest chunk's value
+        if (editor.show_heatmap && !snapshot->telemetry.empty()) {
+            auto max_value = 0.0f;
+            for (const auto& stats : snapshot->telemetry) {
+                max_value = std::max(max_value, heatmap_value(stats, editor.heatmap_metric));
+            }
+            const auto chunks_w = snapshot->width / sand::config::chunk_size;
+            const auto size = static_cast<float>(sand::config::chunk_size);
+            for (std::size_t index = 0; index != snapshot->telemetry.size(); ++index) {
+                const auto value = heatmap_value(snapshot->telemetry[index], editor.heatmap_metric);
+                if (value <= 0.0f) continue;
+                const auto t = value / max_value;
+                const auto pos = glm::vec2{index % chunks_w, index / chunks_w};
+                shape_renderer.draw_quad(size * pos + size / 2.0f, size, size, 0.0f, {t, 0.2f, 1.0f - t, 0.4f});
+            }
+        }
+
+        shape_renderer.draw_circle(snapshot->player_centre, {1.0, 1.0, 0.0, 1.0}, snapshot->player_radius);
 
-        if (show_triangles) {
-            for (const auto& chunk : world->chunks) {
-                render_body_triangles(shape_renderer, chunk.triangles);
+        for (const auto& debris : snapshot->debris) {
+            const auto c = std::cos(debris.angle);
+            const auto s = std::sin(debris.angle);
+            for (const auto& [offset, px] : *debris.pixels) {
+                const auto local = glm::vec2{offset} + 0.5f;
+                const auto centre = debris.position + glm::vec2{c * local.x - s * local.y, s * local.x + c * local.y};
+                shape_renderer.draw_quad(centre, 1.0f, 1.0f, debris.angle, px.colour);
             }
         }
 
+
         if (show_spawn) {
-            shape_renderer.draw_circle(world->spawn_point, {0, 1, 0, 1}, 1.0);
+            shape_renderer.draw_circle(snapshot->spawn_point, {0, 1, 0, 1}, 1.0);
         }
 
         shape_renderer.end_frame();
         
         // Display the UI
-        ui.end_frame();
+        {
+            const auto zone = sand::profile_zone{"ui::end_frame"};
+            ui.end_frame();
+        }
 
         window.swap_buffers();
+        profiler.end_frame();
     }
     
     return 0;
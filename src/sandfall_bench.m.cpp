@@ -0,0 +1,241 @@
+// A headless benchmark for the simulation. Runs a set of generated scenes, plus any
+// level saves given on the command line, for a fixed number of ticks with a fixed seed.
+//
+// Each generated scene is dominated by pixels that use one of the update kernels (powders,
+// liquids, gases, reactions, fire and electricity), so --scene can time them one at a time.
+// --colliders picks how the static pixels become Box2D fixtures, and the fixture count and
+// time spent in b2World::Step are reported so the modes can be compared. Heap allocations
+// are counted over the second half of each run, once the scratch arenas have grown.
+//
+// Usage: sandfall_bench [--ticks N] [--threads N] [--seed N] [--scene NAME]
+//                       [--colliders triangles|convex|chain] [save.bin...]
+#include "world.hpp"
+#include "world_save.hpp"
+#include "pixel.hpp"
+#include "config.hpp"
+#include "update.hpp"
+#include "update_rigid_bodies.hpp"
+#include "utility.hpp"
+#include "thread_pool.hpp"
+#include "profiler.hpp"
+#include "bench.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct scene
+{
+    std::string                                   name;
+    std::function<std::unique_ptr<sand::world>()> make;
+};
+
+auto fill(sand::world& w, glm::ivec2 top_left, glm::ivec2 size, sand::pixel(*maker)()) -> void
+{
+    w.fill_rect(top_left, top_left + size - 1, maker);
+}
+
+auto sand_pile() -> std::unique_ptr<sand::world>
+{
+    auto w = sand::new_world(8, 8);
+    const auto width = static_cast<int>(w->pixels.width());
+    const auto height = static_cast<int>(w->pixels.height());
+    fill(*w, {0, height - 16}, {width, 16}, sand::pixel::rock);
+    fill(*w, {width / 4, 32}, {width / 2, height / 3}, sand::pixel::sand);
+    return w;
+}
+
+auto water_flood() -> std::unique_ptr<sand::world>
+{
+    auto w = sand::new_world(8, 8);
+    const auto width = static_cast<int>(w->pixels.width());
+    const auto height = static_cast<int>(w->pixels.height());
+    fill(*w, {0, height - 16}, {width, 16}, sand::pixel::rock);
+    fill(*w, {0, 0}, {width / 3, height - 16}, sand::pixel::water);
+    return w;
+}
+
+auto steam_rise() -> std::unique_ptr<sand::world>
+{
+    auto w = sand::new_world(8, 8);
+    const auto width = static_cast<int>(w->pixels.width());
+    const auto height = static_cast<int>(w->pixels.height());
+    fill(*w, {0, 0}, {width, 16}, sand::pixel::rock);
+    fill(*w, {0, height / 2}, {width, height / 2}, sand::pixel::steam);
+    return w;
+}
+
+auto acid_bath() -> std::unique_ptr<sand::world>
+{
+    auto w = sand::new_world(8, 8);
+    const auto width = static_cast<int>(w->pixels.width());
+    const auto height = static_cast<int>(w->pixels.height());
+    fill(*w, {0, height - 128}, {width, 128}, sand::pixel::dirt);
+    fill(*w, {0, height - 192}, {width, 64}, sand::pixel::acid);
+    return w;
+}
+
+auto lava_oil_fire() -> std::unique_ptr<sand::world>
+{
+    auto w = sand::new_world(8, 8);
+    const auto width = static_cast<int>(w->pixels.width());
+    const auto height = static_cast<int>(w->pixels.height());
+    fill(*w, {0, height - 16}, {width, 16}, sand::pixel::rock);
+    fill(*w, {0, height - 96}, {width, 80}, sand::pixel::oil);
+    fill(*w, {width / 2 - 32, 32}, {64, 32}, sand::pixel::lava);
+    return w;
+}
+
+auto circuit_grid() -> std::unique_ptr<sand::world>
+{
+    auto w = sand::new_world(8, 8);
+    const auto width = static_cast<int>(w->pixels.width());
+    const auto height = static_cast<int>(w->pixels.height());
+    for (int y = 16; y < height; y += 32) {
+        fill(*w, {0, y}, {width, 1}, sand::pixel::solder);
+    }
+    for (int x = 16; x < width; x += 32) {
+        fill(*w, {x, 0}, {1, height}, sand::pixel::solder);
+    }
+    for (int y = 16; y < height; y += 128) {
+        for (int x = 16; x < width; x += 128) {
+            fill(*w, {x - 2, y - 2}, {5, 5}, sand::pixel::battery);
+        }
+    }
+    return w;
+}
+
+auto awake_chunks(const sand::world& w) -> std::size_t
+{
+    return w.stepping.count();
+}
+
+// The time spent in the zone during the last recorded frame
+auto zone_ms(const sand::profiler& profiler, std::string_view name) -> double
+{
+    if (profiler.num_recorded() == 0) return 0.0;
+    auto total = 0.0;
+    for (const auto& zone : profiler.frame(profiler.num_recorded() - 1).zones) {
+        if (zone.name == name) total += zone.duration_ms;
+    }
+    return total;
+}
+
+auto parse_collider_mode(std::string_view name) -> std::optional<sand::collider_mode>
+{
+    if (name == "triangles") return sand::collider_mode::triangles;
+    if (name == "convex")    return sand::collider_mode::convex;
+    if (name == "chain")     return sand::collider_mode::chain;
+    return std::nullopt;
+}
+
+auto run(const scene& s, int ticks, sand::thread_pool& pool, std::uint64_t seed, sand::collider_mode colliders) -> void
+{
+    using clock = std::chrono::steady_clock;
+
+    // The pixel makers use the generator, so seed it before building the scene too
+    sand::random_seed(seed);
+    auto w = s.make();
+    if (!w) {
+        std::print("{:<16} could not be loaded\n", s.name);
+        return;
+    }
+    w->seed = seed;
+    w->colliders = colliders;
+
+    auto& profiler = sand::get_profiler();
+    auto awake_total = std::size_t{0};
+    auto fixtures_total = std::size_t{0};
+    auto step_ms = 0.0;
+    auto allocations = std::size_t{0};
+    const auto start = clock::now();
+    for (int i = 0; i != ticks; ++i) {
+        if (i == ticks / 2) {
+            allocations = sand::heap_allocations();
+        }
+        profiler.begin_frame();
+        sand::update(*w, pool);
+        profiler.end_frame();
+        awake_total += awake_chunks(*w);
+        fixtures_total += sand::count_fixtures(*w);
+        step_ms += zone_ms(profiler, "b2World::Step");
+    }
+    const auto elapsed = std::chrono::duration<double>{clock::now() - start}.count();
+    allocations = sand::heap_allocations() - allocations;
+
+    const auto pixels = static_cast<double>(w->pixels.width() * w->pixels.height());
+    std::print(
+        "{:<16} {:>10.1f} ticks/s {:>8.3f} ns/pixel {:>8.1f} awake chunks (of {}) {:>8.1f} fixtures {:>8.3f} ms/step {:>8.1f} allocs/tick\n",
+        s.name,
+        ticks / elapsed,
+        1e9 * elapsed / (ticks * pixels),
+        static_cast<double>(awake_total) / ticks,
+        w->chunks.size(),
+        static_cast<double>(fixtures_total) / ticks,
+        step_ms / ticks,
+        static_cast<double>(allocations) / (ticks - ticks / 2)
+    );
+}
+
+}
+
+auto main(int argc, char** argv) -> int
+{
+    auto ticks = 600;
+    auto threads = 1;
+    auto seed = std::uint64_t{0};
+    auto only = std::string{};
+    auto colliders = sand::collider_mode::convex;
+    auto scenes = std::vector<scene>{
+        {"sand_pile",     sand_pile},
+        {"water_flood",   water_flood},
+        {"steam_rise",    steam_rise},
+        {"acid_bath",     acid_bath},
+        {"lava_oil_fire", lava_oil_fire},
+        {"circuit_grid",  circuit_grid}
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        if (arg == "--ticks" && i + 1 < argc) {
+            ticks = std::stoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::stoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--scene" && i + 1 < argc) {
+            only = argv[++i];
+        } else if (arg == "--colliders" && i + 1 < argc) {
+            const auto mode = parse_collider_mode(argv[++i]);
+            if (!mode) {
+                std::print("unknown collider mode {}\n", argv[i]);
+                return 1;
+            }
+            colliders = *mode;
+        } else {
+            const auto path = std::string{arg};
+            scenes.push_back({std::filesystem::path{path}.filename().string(), [path] {
+                return sand::load_world(path);
+            }});
+        }
+    }
+
+    std::print("{} ticks, {} threads, seed {}\n", ticks, threads, seed);
+    auto pool = sand::thread_pool(std::max(1, threads));
+    for (const auto& s : scenes) {
+        if (!only.empty() && s.name != only) continue;
+        run(s, ticks, pool, seed, colliders);
+    }
+}
@@ -0,0 +1,97 @@
+// A benchmark for building the static colliders. Loads each level save given on the
+// command line and rebuilds every collider from scratch a number of times in each collider
+// mode, so the boundaries being traced and triangulated are the ones from real levels.
+//
+// Usage: sandfall_collider_bench [--repeats N] save.bin...
+#include "world.hpp"
+#include "world_save.hpp"
+#include "update_rigid_bodies.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The time spent in the zone during the last recorded frame
+auto zone_ms(const sand::profiler& profiler, std::string_view name) -> double
+{
+    if (profiler.num_recorded() == 0) return 0.0;
+    auto total = 0.0;
+    for (const auto& zone : profiler.frame(profiler.num_recorded() - 1).zones) {
+        if (zone.name == name) total += zone.duration_ms;
+    }
+    return total;
+}
+
+auto run(const std::string& path, int repeats) -> void
+{
+    static constexpr auto modes = std::array{
+        std::pair{"triangles", sand::collider_mode::triangles},
+        std::pair{"convex",    sand::collider_mode::convex},
+        std::pair{"chain",     sand::collider_mode::chain}
+    };
+
+    const auto name = std::filesystem::path{path}.filename().string();
+    auto w = sand::load_world(path);
+    if (!w) {
+        std::print("{:<16} could not be loaded\n", name);
+        return;
+    }
+
+    auto& profiler = sand::get_profiler();
+    for (const auto& [mode_name, mode] : modes) {
+        w->colliders = mode;
+        auto rebuild_ms = 0.0;
+        auto triangulate_ms = 0.0;
+        for (int i = 0; i != repeats; ++i) {
+            profiler.begin_frame();
+            sand::rebuild_colliders(*w);
+            profiler.end_frame();
+            rebuild_ms += zone_ms(profiler, "rebuild_colliders");
+            triangulate_ms += zone_ms(profiler, "triangulate");
+        }
+
+        std::print(
+            "{:<16} {:<10} {:>8.3f} ms/rebuild {:>8.3f} ms triangulating {:>8} fixtures\n",
+            name,
+            mode_name,
+            rebuild_ms / repeats,
+            triangulate_ms / repeats,
+            sand::count_fixtures(*w)
+        );
+    }
+}
+
+}
+
+auto main(int argc, char** argv) -> int
+{
+    auto repeats = 20;
+    auto saves = std::vector<std::string>{};
+
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        if (arg == "--repeats" && i + 1 < argc) {
+            repeats = std::stoi(argv[++i]);
+        } else {
+            saves.emplace_back(arg);
+        }
+    }
+
+    if (saves.empty()) {
+        std::print("usage: sandfall_collider_bench [--repeats N] save.bin...\n");
+        return 1;
+    }
+
+    std::print("{} repeats\n", repeats);
+    for (const auto& save : saves) {
+        run(save, std::max(1, repeats));
+    }
+}
@@ -0,0 +1,424 @@
+// The performance suite. Runs a fixed set of scenarios, the level saves and some synthetic
+// stress cases, for a fixed number of ticks with a fixed seed and writes a JSON report of
+// each one: percentiles of the tick time and of the heap allocations per tick, and how much
+// the resident set grew over the scenario. The first tenth of the ticks are left out of the
+// percentiles while the scratch arenas grow, and scenarios are handed the tick counted from
+// the end of that warm up, so anything they set off at tick 0 is measured.
+//
+// Given a report from an earlier commit with --baseline, each scenario in both is compared
+// and the run fails if any metric has grown by more than the tolerance, so a slowdown in
+// the update or the collider building is caught before it is merged. --label is stored in
+// the report to say which commit it came from.
+//
+// Usage: sandfall_perf [--ticks N] [--threads N] [--seed N] [--scenario NAME]
+//                      [--out report.json] [--baseline report.json] [--tolerance 0.1]
+//                      [--label NAME] [save.bin...]
+#include "world.hpp"
+#include "world_save.hpp"
+#include "pixel.hpp"
+#include "config.hpp"
+#include "update.hpp"
+#include "utility.hpp"
+#include "thread_pool.hpp"
+#include "serialise.hpp"
+#include "bench.hpp"
+
+#include <glm/glm.hpp>
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct scenario
+{
+    std::string                                   name;
+    std::function<std::unique_ptr<sand::world>()> make;
+    std::function<void(sand::world&, int)>        before_tick; // Negative ticks are the warm up, may be empty
+};
+
+struct scenario_result
+{
+    std::string name;
+    std::size_t ticks       = 0;
+    double      tick_ms_p50 = 0.0;
+    double      tick_ms_p90 = 0.0;
+    double      tick_ms_p99 = 0.0;
+    double      tick_ms_max = 0.0;
+    double      allocs_p50  = 0.0;
+    double      allocs_p99  = 0.0;
+    double      rss_growth_mb = 0.0; // Resident memory gained by the end, with the world still alive
+
+    auto serialise(auto& archive) -> void
+    {
+        archive(
+            CEREAL_NVP(name),
+            CEREAL_NVP(ticks),
+            CEREAL_NVP(tick_ms_p50),
+            CEREAL_NVP(tick_ms_p90),
+            CEREAL_NVP(tick_ms_p99),
+            CEREAL_NVP(tick_ms_max),
+            CEREAL_NVP(allocs_p50),
+            CEREAL_NVP(allocs_p99),
+            CEREAL_NVP(rss_growth_mb)
+        );
+    }
+};
+
+struct perf_report
+{
+    std::string                  label;
+    int                          threads = 1;
+    std::uint64_t                seed    = 0;
+    std::vector<scenario_result> scenarios;
+
+    auto serialise(auto& archive) -> void
+    {
+        archive(CEREAL_NVP(label), CEREAL_NVP(threads), CEREAL_NVP(seed), CEREAL_NVP(scenarios));
+    }
+};
+
+// The current resident set rather than the peak, which is the high water mark of the whole
+// process and so would be the same for every scenario after the largest
+auto rss_mb() -> double
+{
+    constexpr auto megabyte = 1024.0 * 1024.0;
+#ifdef _WIN32
+    auto counters = PROCESS_MEMORY_COUNTERS{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<double>(counters.WorkingSetSize) / megabyte;
+#elif defined(__APPLE__)
+    auto info = mach_task_basic_info_data_t{};
+    auto count = mach_msg_type_number_t{MACH_TASK_BASIC_INFO_COUNT};
+    task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count);
+    return static_cast<double>(info.resident_size) / megabyte;
+#else
+    // The second field of statm is the resident pages
+    auto statm = std::ifstream{"/proc/self/statm"};
+    auto size = std::size_t{0};
+    auto resident = std::size_t{0};
+    statm >> size >> resident;
+    return static_cast<double>(resident) * static_cast<double>(sysconf(_SC_PAGESIZE)) / megabyte;
+#endif
+}
+
+// The nearest rank percentile, p in [0, 1]
+auto percentile(std::vector<double> values, double p) -> double
+{
+    if (values.empty()) return 0.0;
+    const auto rank = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+    std::ranges::nth_element(values, values.begin() + rank);
+    return values[rank];
+}
+
+auto add_floor(sand::world& w, int depth) -> void
+{
+    const auto width = static_cast<int>(w.pixels.width());
+    const auto height = static_cast<int>(w.pixels.height());
+    w.fill_rect({0, height - depth}, {width - 1, height - 1}, sand::pixel::rock);
+}
+
+// Sand falls across the whole width of the world every tick, so every chunk ends up awake
+// and the pile keeps growing
+auto sand_rain() -> scenario
+{
+    const auto make = [] {
+        auto w = sand::new_world(8, 8);
+        add_floor(*w, 16);
+        return w;
+    };
+    const auto before_tick = [](sand::world& w, int tick) {
+        auto x = 0;
+        w.fill_span(0, 0, static_cast<int>(w.pixels.width()) - 1, [&] {
+            return (x++ + tick) % 4 == 0 ? sand::pixel::sand() : sand::pixel::air();
+        });
+    };
+    return {"sand_rain", make, before_tick};
+}
+
+// 500 blocks of c4 buried in rock. Each is given a battery of its own once the warm up is
+// over, so they are all set off by the circuits within a few measured ticks and land in the
+// same explosion batches.
+auto c4_blasts() -> scenario
+{
+    const auto block = [](int row, int col) { return glm::ivec2{10 + 20 * col, 10 + 20 * row}; };
+    const auto make = [block] {
+        auto w = sand::new_world(8, 7);
+        const auto width = static_cast<int>(w->pixels.width());
+        const auto height = static_cast<int>(w->pixels.height());
+        w->fill_rect({0, 0}, {width - 1, height - 1}, sand::pixel::rock);
+        for (int row = 0; row != 20; ++row) {
+            for (int col = 0; col != 25; ++col) {
+                const auto pos = block(row, col);
+                w->fill_rect(pos, pos + 1, sand::pixel::c4);
+            }
+        }
+        return w;
+    };
+    const auto before_tick = [block](sand::world& w, int tick) {
+        if (tick != 0) return;
+        for (int row = 0; row != 20; ++row) {
+            for (int col = 0; col != 25; ++col) {
+                const auto pos = block(row, col);
+                w.fill_rect(pos + glm::ivec2{2, 0}, pos + glm::ivec2{2, 1}, sand::pixel::battery);
+            }
+        }
+    };
+    return {"c4_blasts", make, before_tick};
+}
+
+// 20 rows of 500 solder pixels resting on rock shelves, each powered from a battery at its
+// left end, so the circuit network steps 10000 conductors every tick
+auto solder_circuit() -> scenario
+{
+    const auto make = [] {
+        auto w = sand::new_world(8, 8);
+        for (int row = 0; row != 20; ++row) {
+            const auto y = 16 + 24 * row;
+            w->fill_rect({4, y + 1}, {505, y + 1}, sand::pixel::rock);
+            w->fill_rect({6, y}, {505, y}, sand::pixel::solder);
+            w->fill_rect({4, y}, {5, y}, sand::pixel::battery);
+        }
+        return w;
+    };
+    return {"solder_circuit", make, {}};
+}
+
+// A block of rock in every chunk is filled and cleared on alternate ticks, so the islands
+// of every chunk near the player change and their colliders are built again every tick
+auto chunk_thrash() -> scenario
+{
+    const auto make = [] {
+        auto w = sand::new_world(8, 8);
+        add_floor(*w, 16);
+        w->player.set_position(glm::ivec2{w->pixels.width() / 2, w->pixels.height() / 2});
+        return w;
+    };
+    const auto before_tick = [](sand::world& w, int tick) {
+        const auto chunks = glm::ivec2{w.pixels.width(), w.pixels.height()} / sand::config::chunk_size;
+        for (int y = 0; y != chunks.y; ++y) {
+            for (int x = 0; x != chunks.x; ++x) {
+                const auto centre = sand::config::chunk_size * glm::ivec2{x, y} + sand::config::chunk_size / 2;
+                const auto maker = tick % 2 == 0 ? sand::pixel::rock : sand::pixel::air;
+                w.fill_rect(centre - 8, centre + 7, maker);
+            }
+        }
+    };
+    return {"chunk_thrash", make, before_tick};
+}
+
+auto run(const scenario& s, int ticks, sand::thread_pool& pool, std::uint64_t seed) -> std::optional<scenario_result>
+{
+    using clock = std::chrono::steady_clock;
+
+    // The pixel makers use the generator, so seed it before building the scenario too
+    const auto rss_before = rss_mb();
+    sand::random_seed(seed);
+    auto w = s.make();
+    if (!w) return std::nullopt;
+    w->seed = seed;
+
+    const auto warm_up = ticks / 10;
+    auto tick_ms = std::vector<double>{};
+    auto allocs = std::vector<double>{};
+    tick_ms.reserve(ticks);
+    allocs.reserve(ticks);
+    for (int i = 0; i != ticks; ++i) {
+        if (s.before_tick) {
+            s.before_tick(*w, i - warm_up);
+        }
+        const auto allocations = sand::heap_allocations();
+        const auto start = clock::now();
+        sand::update(*w, pool);
+        const auto elapsed = std::chrono::duration<double, std::milli>{clock::now() - start}.count();
+        if (i < warm_up) continue;
+        tick_ms.push_back(elapsed);
+        allocs.push_back(static_cast<double>(sand::heap_allocations() - allocations));
+    }
+
+    return scenario_result{
+        .name = s.name,
+        .ticks = tick_ms.size(),
+        .tick_ms_p50 = percentile(tick_ms, 0.5),
+        .tick_ms_p90 = percentile(tick_ms, 0.9),
+        .tick_ms_p99 = percentile(tick_ms, 0.99),
+        .tick_ms_max = tick_ms.empty() ? 0.0 : std::ranges::max(tick_ms),
+        .allocs_p50 = percentile(allocs, 0.5),
+        .allocs_p99 = percentile(allocs, 0.99),
+        .rss_growth_mb = rss_mb() - rss_before
+    };
+}
+
+// Times below the floor are too noisy to compare as a ratio
+auto regressed(double baseline, double current, double tolerance, double floor) -> bool
+{
+    return current > std::max(baseline * (1.0 + tolerance), baseline + floor);
+}
+
+// Prints every metric that grew beyond the tolerance and returns how many there were
+auto compare(const perf_report& baseline, const perf_report& current, double tolerance) -> int
+{
+    auto regressions = 0;
+    for (const auto& now : current.scenarios) {
+        const auto it = std::ranges::find(baseline.scenarios, now.name, &scenario_result::name);
+        if (it == baseline.scenarios.end()) {
+            std::print(stderr, "{:<16} not in the baseline\n", now.name);
+            continue;
+        }
+        const auto check = [&](std::string_view metric, double base, double value, double floor) {
+            if (regressed(base, value, tolerance, floor)) {
+                std::print(stderr, "{:<16} {:<12} regressed {:.3f} -> {:.3f}\n", now.name, metric, base, value);
+                ++regressions;
+            }
+        };
+        check("tick_ms_p50", it->tick_ms_p50, now.tick_ms_p50, 0.05);
+        check("tick_ms_p90", it->tick_ms_p90, now.tick_ms_p90, 0.05);
+        check("tick_ms_p99", it->tick_ms_p99, now.tick_ms_p99, 0.1);
+        check("allocs_p50", it->allocs_p50, now.allocs_p50, 1.0);
+        check("allocs_p99", it->allocs_p99, now.allocs_p99, 1.0);
+        check("rss_growth_mb", it->rss_growth_mb, now.rss_growth_mb, 1.0);
+    }
+    return regressions;
+}
+
+auto load_report(const std::string& path) -> std::optional<perf_report>
+{
+    auto file = std::ifstream{path};
+    if (!file) return std::nullopt;
+    auto report = perf_report{};
+    {
+        auto archive = cereal::JSONInputArchive{file};
+        archive(cereal::make_nvp("report", report));
+    }
+    return report;
+}
+
+auto write_report(std::ostream& out, const perf_report& report) -> void
+{
+    // The archive only finishes the document when it is destroyed
+    auto archive = cereal::JSONOutputArchive{out};
+    archive(cereal::make_nvp("report", report));
+}
+
+}
+
+auto main(int argc, char** argv) -> int
+{
+    auto ticks = 600;
+    auto threads = 1;
+    auto seed = std::uint64_t{0};
+    auto only = std::string{};
+    auto out_path = std::string{};
+    auto baseline_path = std::string{};
+    auto tolerance = 0.1;
+    auto label = std::string{};
+    auto saves = std::vector<std::string>{};
+
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        if (arg == "--ticks" && i + 1 < argc) {
+            ticks = std::stoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::stoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--scenario" && i + 1 < argc) {
+            only = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::stod(argv[++i]);
+        } else if (arg == "--label" && i + 1 < argc) {
+            label = argv[++i];
+        } else {
+            saves.emplace_back(arg);
+        }
+    }
+
+    if (ticks < 1) {
+        std::print(stderr, "--ticks must be at least 1\n");
+        return 1;
+    }
+
+    // The levels shipped with the editor, when no others are given
+    if (saves.empty()) {
+        for (int i = 0; i != 5; ++i) {
+            saves.push_back(std::format("save{}.bin", i));
+        }
+    }
+
+    auto scenarios = std::vector<scenario>{};
+    for (const auto& path : saves) {
+        if (!std::filesystem::exists(path)) {
+            std::print(stderr, "skipping {}, it does not exist\n", path);
+            continue;
+        }
+        scenarios.push_back({std::filesystem::path{path}.filename().string(), [path] {
+            return sand::load_world(path);
+        }, {}});
+    }
+    scenarios.push_back(sand_rain());
+    scenarios.push_back(c4_blasts());
+    scenarios.push_back(solder_circuit());
+    scenarios.push_back(chunk_thrash());
+
+    auto report = perf_report{.label = label, .threads = std::max(1, threads), .seed = seed};
+    auto pool = sand::thread_pool(report.threads);
+    for (const auto& s : scenarios) {
+        if (!only.empty() && s.name != only) continue;
+        if (auto result = run(s, ticks, pool, seed)) {
+            std::print(stderr, "{:<16} {:>8.3f} ms p50 {:>8.3f} ms p99 {:>8.1f} allocs p50\n",
+                result->name, result->tick_ms_p50, result->tick_ms_p99, result->allocs_p50);
+            report.scenarios.push_back(std::move(*result));
+        } else {
+            std::print(stderr, "{:<16} could not be loaded\n", s.name);
+        }
+    }
+
+    if (out_path.empty()) {
+        write_report(std::cout, report);
+        std::cout << '\n';
+    } else {
+        auto file = std::ofstream{out_path};
+        write_report(file, report);
+    }
+
+    if (!baseline_path.empty()) {
+        const auto baseline = load_report(baseline_path);
+        if (!baseline) {
+            std::print(stderr, "could not read the baseline {}\n", baseline_path);
+            return 1;
+        }
+        const auto regressions = compare(*baseline, report, tolerance);
+        if (regressions > 0) {
+            std::print(stderr, "{} regressions against {}\n", regressions, baseline->label);
+            return 1;
+        }
+        std::print(stderr, "no regressions against {}\n", baseline->label);
+    }
+}
@@ -0,0 +1,85 @@
+// Plays back a recording made in the editor as fast as it will go, checking the hash of the
+// pixels after every tick against the one recorded. Playing the same recording with
+// different thread counts shows whether the scheduler gives the same result however the
+// chunks are shared out, and timing it before and after a change measures a slowdown on
+// exactly the same workload. Only the ticks are timed, not the hashing.
+//
+// Usage: sandfall_replay [--threads N] [--no-verify] replay.bin
+#include "replay.hpp"
+#include "world.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+
+auto main(int argc, char** argv) -> int
+{
+    auto threads = 1;
+    auto verify = true;
+    auto path = std::string{};
+
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::stoi(argv[++i]);
+        } else if (arg == "--no-verify") {
+            verify = false;
+        } else {
+            path = arg;
+        }
+    }
+    if (path.empty()) {
+        std::print("usage: sandfall_replay [--threads N] [--no-verify] replay.bin\n");
+        return 1;
+    }
+
+    const auto r = sand::load_replay(path);
+    if (!r) {
+        std::print("could not load {}\n", path);
+        return 1;
+    }
+
+    auto pool = sand::thread_pool(std::max(1, threads));
+    auto w = sand::replay_world(*r, pool);
+    if (!w) {
+        std::print("{} has a corrupt initial world\n", path);
+        return 1;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto elapsed = clock::duration{};
+    auto mismatch = std::optional<std::size_t>{};
+    for (std::size_t i = 0; i != r->ticks.size(); ++i) {
+        const auto start = clock::now();
+        sand::replay_tick_world(*w, r->ticks[i], pool);
+        elapsed += clock::now() - start;
+
+        if (verify && sand::hash_pixels(*w) != r->ticks[i].hash) {
+            mismatch = i;
+            break;
+        }
+    }
+
+    const auto ticks = mismatch ? *mismatch + 1 : r->ticks.size();
+    const auto seconds = std::chrono::duration<double>{elapsed}.count();
+    std::print(
+        "{} ticks, {} threads, seed {}: {:.1f} ticks/s, {:.3f} ms/tick\n",
+        ticks,
+        threads,
+        r->seed,
+        ticks / seconds,
+        1e3 * seconds / ticks
+    );
+
+    if (mismatch) {
+        std::print("diverged from the recording at tick {}\n", *mismatch);
+        return 1;
+    }
+    if (verify) {
+        std::print("every tick matched the recording\n");
+    }
+}
@@ -0,0 +1,77 @@
+#include "scratch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+
+namespace sand {
+
+auto scratch_arena::do_allocate(std::size_t bytes, std::size_t alignment) -> void*
+{
+    if (!d_blocks.empty()) {
+        auto& last = d_blocks.back();
+        void* ptr = last.data.get() + d_used;
+        auto space = last.size - d_used;
+        if (std::align(alignment, bytes, ptr, space)) {
+            d_used = last.size - space + bytes;
+            return ptr;
+        }
+    }
+
+    // Blocks double in size so a tick that needs a lot more than the last only takes a few
+    const auto size = std::max({bytes + alignment, capacity(), std::size_t{64 * 1024}});
+    d_blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(size), size});
+    d_used = 0;
+    return do_allocate(bytes, alignment);
+}
+
+auto scratch_arena::reset() -> void
+{
+    if (d_blocks.size() > 1) {
+        const auto size = capacity();
+        d_blocks.clear();
+        d_blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(size), size});
+    }
+    d_used = 0;
+}
+
+auto scratch_arena::capacity() const -> std::size_t
+{
+    auto total = std::size_t{0};
+    for (const auto& b : d_blocks) {
+        total += b.size;
+    }
+    return total;
+}
+
+auto scratch_arena::for_this_thread(std::uint64_t epoch) -> scratch_arena&
+{
+    assert(epoch != 0); // Only used within a scratch_scope
+    static thread_local scratch_arena arena;
+    if (arena.d_epoch != epoch) {
+        arena.reset();
+        arena.d_epoch = epoch;
+    }
+    return arena;
+}
+
+scratch_scope::scratch_scope(std::uint64_t& epoch)
+    : d_epoch{epoch}
+    , d_outermost{epoch == 0}
+{
+    // Shared by every world, so two worlds never hand their threads the same epoch
+    static auto next_epoch = std::atomic<std::uint64_t>{1};
+    if (d_outermost) {
+        d_epoch = next_epoch.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+scratch_scope::~scratch_scope()
+{
+    if (d_outermost) {
+        d_epoch = 0;
+    }
+}
+
+}
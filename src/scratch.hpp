@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace sand {
+
+// A bump allocator for the short lived buffers of one thread. Deallocating does nothing,
+// instead the whole arena is reset at once. The blocks are kept across resets and merged
+// into one, so once the arena has grown to fit the work of a scope it stops allocating.
+class scratch_arena : public std::pmr::memory_resource
+{
+    struct block
+    {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t                  size;
+    };
+
+    std::vector<block> d_blocks; // Only the last has space left
+    std::size_t        d_used  = 0; // Of the last block
+    std::uint64_t      d_epoch = 0;
+
+    auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override;
+    auto do_deallocate(void*, std::size_t, std::size_t) -> void override {}
+    auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override
+    {
+        return this == &other;
+    }
+
+public:
+    // Frees everything handed out since the last reset
+    auto reset() -> void;
+
+    auto capacity() const -> std::size_t;
+
+    // The arena of the calling thread. It is reset first if it was last used with a
+    // different epoch, which is the one set by the scratch_scope it is used within.
+    static auto for_this_thread(std::uint64_t epoch) -> scratch_arena&;
+};
+
+// Marks out a piece of work that uses the arenas, such as one call to update. The outermost
+// scope gives the epoch a value no scope has had before and clears it again at the end, so
+// every thread's arena is reset the first time it is used in each scope, however many run
+// in a tick. Nothing from the arenas may outlive the outermost scope.
+class scratch_scope
+{
+    std::uint64_t& d_epoch;
+    bool           d_outermost;
+
+    scratch_scope(const scratch_scope&) = delete;
+    scratch_scope& operator=(const scratch_scope&) = delete;
+
+public:
+    explicit scratch_scope(std::uint64_t& epoch);
+    ~scratch_scope();
+};
+
+}
@@ -0,0 +1,218 @@
+#include "simulation.hpp"
+#include "update.hpp"
+#include "paging.hpp"
+#include "world_save.hpp"
+#include "config.hpp"
+#include "profiler.hpp"
+
+#include <chrono>
+#include <print>
+#include <utility>
+
+namespace sand {
+
+simulation::simulation(std::unique_ptr<world> w, std::size_t num_threads)
+    : d_world{std::move(w)}
+    , d_pool{std::make_unique<thread_pool>(num_threads)}
+{}
+
+simulation::~simulation()
+{
+    set_threaded(false);
+    delete d_latest.exchange(nullptr);
+}
+
+auto simulation::tick() -> void
+{
+    run_commands();
+    update(*d_world, *d_pool);
+
+    auto input = keyboard{};
+    {
+        const auto lock = std::scoped_lock{d_mutex};
+        input = d_input;
+        d_input.on_new_frame();
+    }
+    d_world->player.update(input);
+
+    if (d_recording) {
+        d_recording->ticks.push_back({std::exchange(d_recorded_edits, {}), input, hash_pixels(*d_world)});
+    }
+
+    // Skipped while the last one is still being written, rather than piling up behind it
+    if (++d_ticks_since_autosave >= config::autosave_interval && !d_autosaver.is_busy()) {
+        d_autosaver.save(*d_world, config::autosave_path);
+        d_ticks_since_autosave = 0;
+    }
+}
+
+auto simulation::queue(std::move_only_function<void()> f) -> void
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    d_commands.push_back(std::move(f));
+}
+
+auto simulation::run_commands() -> void
+{
+    auto commands = std::vector<std::move_only_function<void()>>{};
+    {
+        const auto lock = std::scoped_lock{d_mutex};
+        commands.swap(d_commands);
+    }
+    for (auto& command : commands) {
+        command();
+    }
+}
+
+auto simulation::publish() -> void
+{
+    // A snapshot the frontend never took is folded into the new one rather than lost
+    auto options = snapshot_options{};
+    {
+        const auto lock = std::scoped_lock{d_mutex};
+        options = d_options;
+    }
+    if (const auto unread = std::unique_ptr<world_snapshot>{d_latest.exchange(nullptr)}) {
+        return_snapshot(*d_world, *unread);
+        options.everything |= unread->everything;
+    }
+    auto snapshot = sand::take_snapshot(*d_world, options);
+    snapshot->recorded_ticks = d_recording ? std::optional{d_recording->ticks.size()} : std::nullopt;
+
+    // After the snapshot, so chunks waiting to be drawn in view are read before paging out
+    update_paging(*d_world, *d_pool, d_world->player.centre());
+    d_latest.store(snapshot.release());
+}
+
+auto simulation::run(std::stop_token token) -> void
+{
+    using clock = std::chrono::steady_clock;
+    const auto step = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>{config::time_step});
+
+    // Ticks keep to the time step, and when they fall behind by more than a few the
+    // backlog is dropped rather than run flat out to catch up
+    auto next = clock::now();
+    while (!token.stop_requested()) {
+        tick();
+        publish();
+        next += step;
+        const auto now = clock::now();
+        if (next + 4 * step < now) {
+            next = now;
+        } else {
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+auto simulation::set_threaded(bool threaded) -> void
+{
+    if (threaded == is_threaded()) return;
+    if (threaded) {
+        d_thread = std::jthread{[this](std::stop_token token) { run(token); }};
+    } else {
+        d_thread.request_stop();
+        d_thread.join();
+        d_accumulator = 0.0;
+    }
+}
+
+auto simulation::advance(double dt) -> void
+{
+    if (is_threaded()) return;
+    run_commands();
+    d_accumulator += dt;
+    while (d_accumulator > config::time_step) {
+        d_accumulator -= config::time_step;
+        tick();
+    }
+    publish();
+}
+
+auto simulation::post(std::function<void(world&)> command) -> void
+{
+    queue([this, command = std::move(command)] {
+        if (d_recording) {
+            std::print("Recording dropped by a command that cannot be recorded\n");
+            d_recording.reset();
+        }
+        command(*d_world);
+    });
+}
+
+auto simulation::edit(world_edit e) -> void
+{
+    queue([this, e = std::move(e)] {
+        apply_edit(*d_world, e);
+        if (d_recording) {
+            d_recorded_edits.push_back(e);
+        }
+    });
+}
+
+auto simulation::start_recording(std::uint64_t seed) -> void
+{
+    queue([this, seed] {
+        d_recording = begin_replay(d_world, seed, *d_pool);
+        d_recorded_edits.clear();
+    });
+}
+
+auto simulation::stop_recording(const std::string& file_path) -> void
+{
+    queue([this, file_path] {
+        if (!d_recording) return;
+        save_replay(file_path, *d_recording);
+        std::print("Recorded {} ticks to {}\n", d_recording->ticks.size(), file_path);
+        d_recording.reset();
+    });
+}
+
+auto simulation::set_input(const keyboard& input) -> void
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    d_input.hold(input);
+}
+
+auto simulation::set_snapshot_options(const snapshot_options& options) -> void
+{
+    const auto lock = std::scoped_lock{d_mutex};
+    d_options = options;
+}
+
+auto simulation::replace_world(std::unique_ptr<world> w) -> void
+{
+    queue([this, w = std::move(w)] mutable {
+        d_world = std::move(w);
+        d_recording.reset();
+    });
+}
+
+auto simulation::set_num_threads(std::size_t num_threads) -> void
+{
+    queue([this, num_threads] { d_pool = std::make_unique<thread_pool>(num_threads); });
+}
+
+auto simulation::save(const std::string& file_path) -> void
+{
+    queue([this, file_path] { d_autosaver.save(*d_world, file_path); });
+}
+
+auto simulation::load(const std::string& file_path) -> void
+{
+    queue([this, file_path] {
+        if (auto loaded = load_world(file_path, *d_pool)) {
+            d_world = std::move(loaded);
+            d_recording.reset();
+        } else {
+            std::print("Could not load {}\n", file_path);
+        }
+    });
+}
+
+auto simulation::take_snapshot() -> std::unique_ptr<world_snapshot>
+{
+    return std::unique_ptr<world_snapshot>{d_latest.exchange(nullptr)};
+}
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "world.hpp"
+#include "snapshot.hpp"
+#include "mouse.hpp"
+#include "thread_pool.hpp"
+#include "replay.hpp"
+#include "autosave.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sand {
+
+// Owns the world and steps it at the fixed time step, either from the frontend's loop on
+// every frame or on a thread of its own. The frontend never touches the world directly, it
+// posts commands which are run between ticks and draws the latest published snapshot. On
+// its own thread a slow tick no longer holds up drawing, panning or the UI.
+class simulation
+{
+    std::unique_ptr<world>       d_world;
+    std::unique_ptr<thread_pool> d_pool;
+    double                       d_accumulator = 0.0;
+    autosaver                    d_autosaver;
+    std::size_t                  d_ticks_since_autosave = 0;
+
+    std::optional<replay>   d_recording;
+    std::vector<world_edit> d_recorded_edits; // Since the last tick
+
+    // Everything below is shared with the frontend
+    std::mutex                                d_mutex;
+    std::vector<std::move_only_function<void()>> d_commands;
+    keyboard                                  d_input;
+    snapshot_options                          d_options; // Too big to be a lock free atomic
+    std::atomic<world_snapshot*>              d_latest = nullptr; // Published and not yet taken
+
+    std::jthread d_thread;
+
+    auto tick() -> void;
+    auto queue(std::move_only_function<void()> f) -> void;
+    auto run_commands() -> void;
+    auto publish() -> void;
+    auto run(std::stop_token token) -> void;
+
+    simulation(const simulation&) = delete;
+    simulation& operator=(const simulation&) = delete;
+
+public:
+    simulation(std::unique_ptr<world> w, std::size_t num_threads);
+    ~simulation();
+
+    // Moves the simulation on or off its own thread. Off it, advance steps it instead.
+    auto set_threaded(bool threaded) -> void;
+    auto is_threaded() const -> bool { return d_thread.joinable(); }
+
+    // Runs as many ticks as have built up, when not threaded, then publishes a snapshot
+    auto advance(double dt) -> void;
+
+    // Runs on the simulation's thread before its next tick, in the order posted. Commands
+    // are not recorded, so one posted while recording ends the recording, as loading does.
+    // Changes that should keep a recording going are made with edit instead.
+    auto post(std::function<void(world&)> command) -> void;
+
+    // Posts an edit, which is also recorded if a recording is running
+    auto edit(world_edit e) -> void;
+
+    // Recording restarts the world from a copy of itself, as described at begin_replay, in
+    // deterministic mode with the given seed, and then keeps every edit, the input and the
+    // hash of each tick until stopped and written to the file. Posting a command, loading or
+    // replacing the world drops the recording.
+    auto start_recording(std::uint64_t seed) -> void;
+    auto stop_recording(const std::string& file_path) -> void;
+
+    // The input the player sees from its next tick. Keys pressed since the last tick are
+    // held onto so that a tap between ticks is not missed.
+    auto set_input(const keyboard& input) -> void;
+
+    auto replace_world(std::unique_ptr<world> w) -> void;
+    auto set_num_threads(std::size_t num_threads) -> void;
+
+    // Saves are taken on the simulation's thread before its next tick and written in the
+    // background. The world is also autosaved every config::autosave_interval ticks.
+    auto save(const std::string& file_path) -> void;
+
+    // Loads on the simulation's thread, keeping the current world if the load fails
+    auto load(const std::string& file_path) -> void;
+
+    auto set_snapshot_options(const snapshot_options& options) -> void;
+
+    // The snapshot published since the last call, or null if there hasn't been one. Never
+    // waits for the simulation.
+    auto take_snapshot() -> std::unique_ptr<world_snapshot>;
+};
+
+}
@@ -0,0 +1,139 @@
+#include "snapshot.hpp"
+#include "world.hpp"
+#include "update_rigid_bodies.hpp"
+#include "utility.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+namespace sand {
+namespace {
+
+auto add_collider_lines(const b2Body* body, collider_outline& lines) -> void
+{
+    if (!body) return;
+    for (auto fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext()) {
+        if (fixture->GetShape()->GetType() == b2Shape::Type::e_polygon) {
+            const auto* shape = static_cast<const b2PolygonShape*>(fixture->GetShape());
+            for (int i = 0; i != shape->m_count; ++i) {
+                lines.emplace_back(
+                    physics_to_pixel(shape->m_vertices[i]),
+                    physics_to_pixel(shape->m_vertices[(i + 1) % shape->m_count])
+                );
+            }
+        }
+        else if (fixture->GetShape()->GetType() == b2Shape::Type::e_chain) {
+            const auto* shape = static_cast<const b2ChainShape*>(fixture->GetShape());
+            for (int i = 0; i + 1 < shape->m_count; ++i) {
+                lines.emplace_back(
+                    physics_to_pixel(shape->m_vertices[i]),
+                    physics_to_pixel(shape->m_vertices[i + 1])
+                );
+            }
+        }
+    }
+}
+
+}
+
+auto take_snapshot(world& w, const snapshot_options& options) -> std::unique_ptr<world_snapshot>
+{
+    const auto zone = profile_zone{"take_snapshot"};
+    auto snapshot = std::make_unique<world_snapshot>(world_snapshot{
+        .width = w.pixels.width(),
+        .height = w.pixels.height(),
+        .tick = w.tick,
+        .everything = options.everything,
+        .player_centre = w.player.centre(),
+        .player_radius = static_cast<float>(w.player.radius()),
+        .spawn_point = w.spawn_point,
+        .colliders = w.colliders,
+        .level_liquids = w.level_liquids,
+        .deterministic = w.seed.has_value(),
+        .num_fixtures = count_fixtures(w),
+        .num_proxies = w.physics.GetProxyCount(),
+        .enabled_chunk_bodies = w.physics_enabled.count(),
+        .awake_chunks = w.stepping.count(),
+        .resident_pages = w.pixels.num_resident_pages(),
+        .paged_out = w.pixels.num_paged_out()
+    });
+
+    const auto& pixels = std::as_const(w.pixels);
+    for (std::size_t index = 0; index != w.chunks.size(); ++index) {
+        // Pixels can only have changed if they were marked for redrawing during the steps
+        // since the last snapshot, or have been woken since by editing. Paged out chunks
+        // are asleep so their highlight is already off. Reading a chunk that paged out
+        // before it was drawn faults it back in until the next call to update_paging.
+        auto& c = w.chunks[index];
+        const auto scanned = merge(c.dirty, c.dirty_next);
+        const auto dirty = merge(std::exchange(c.redraw, {}), c.dirty_next);
+        const auto scan_all = options.scanned && !pixels.is_paged_out(index);
+        if (dirty.empty() && !options.everything && !scan_all) continue;
+
+        const auto rect = (options.everything || scan_all) ? chunk_rect::full() : dirty;
+        const auto pos = get_chunk_pos(w, index);
+        const auto in_view = options.view_min.x <= pos.x && pos.x <= options.view_max.x
+                          && options.view_min.y <= pos.y && pos.y <= options.view_max.y;
+        if (!in_view) {
+            c.redraw = rect;
+            continue;
+        }
+
+        const auto size = rect.max - rect.min + 1;
+        auto& out = snapshot->chunks.emplace_back(chunk_snapshot{.index = index, .rect = rect});
+        out.colours.reserve(size.x * size.y);
+        out.states.reserve(size.x * size.y);
+
+        const auto top_left = config::chunk_size * pos;
+        for (int y = rect.min.y; y <= rect.max.y; ++y) {
+            for (int x = rect.min.x; x <= rect.max.x; ++x) {
+                const auto pixel = pixels[top_left + glm::ivec2{x, y}];
+                const auto in_scanned = scanned.min.x <= x && x <= scanned.max.x
+                                     && scanned.min.y <= y && y <= scanned.max.y;
+                out.colours.push_back(pixel.colour.rgba());
+                out.states.push_back(pack_state(pixel.type, pixel.flags[is_burning], pixel.power, options.scanned && in_scanned));
+            }
+        }
+    }
+
+    snapshot->debris.reserve(w.debris.size());
+    for (const auto& d : w.debris) {
+        snapshot->debris.push_back({physics_to_pixel(d.body->GetPosition()), d.body->GetAngle(), d.pixels});
+    }
+
+    if (options.colliders) {
+        snapshot->collider_outlines.reserve(w.chunks.size());
+        for (auto& c : w.chunks) {
+            if (c.outline_version != c.collider_version) {
+                auto outline = std::make_shared<collider_outline>();
+                add_collider_lines(c.triangles, *outline);
+                c.outline = std::move(outline);
+                c.outline_version = c.collider_version;
+            }
+            snapshot->collider_outlines.push_back(c.outline);
+        }
+    }
+
+    if (options.telemetry) {
+        snapshot->telemetry.reserve(w.chunks.size());
+        for (const auto& c : w.chunks) {
+            auto& stats = snapshot->telemetry.emplace_back(c.stats.tick + 1 == w.tick ? c.stats : chunk_stats{});
+            for (const auto& island : c.islands) {
+                stats.fixtures += static_cast<std::uint32_t>(island.fixtures.size());
+            }
+        }
+    }
+    return snapshot;
+}
+
+auto return_snapshot(world& w, const world_snapshot& unread) -> void
+{
+    if (unread.width != w.pixels.width() || unread.height != w.pixels.height()) return;
+    for (const auto& c : unread.chunks) {
+        w.chunks[c.index].redraw = merge(w.chunks[c.index].redraw, c.rect);
+    }
+}
+
+}
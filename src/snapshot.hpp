@@ -0,0 +1,103 @@
+#pragma once
+#include "world.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace sand {
+
+// A region of a chunk to draw, with a pair of words per pixel in row order over the rect.
+// The state word packs the type, the burning flag, the power and whether the pixel was
+// scanned into its bytes, in the layout of the renderer's state texture.
+struct chunk_snapshot
+{
+    std::size_t                index;
+    chunk_rect                 rect;
+    std::vector<std::uint32_t> colours; // Packed RGBA8
+    std::vector<std::uint32_t> states;
+};
+
+inline auto pack_state(pixel_type type, bool burning, std::uint8_t power, bool scanned) -> std::uint32_t
+{
+    return static_cast<std::uint32_t>(type)
+         | (static_cast<std::uint32_t>(burning) << 8)
+         | (static_cast<std::uint32_t>(power) << 16)
+         | (static_cast<std::uint32_t>(scanned) << 24);
+}
+
+inline auto state_type(std::uint32_t state) -> pixel_type { return static_cast<pixel_type>(state & 0xff); }
+inline auto state_burning(std::uint32_t state) -> bool { return (state >> 8) & 1u; }
+inline auto state_power(std::uint32_t state) -> std::uint8_t { return (state >> 16) & 0xff; }
+inline auto state_scanned(std::uint32_t state) -> bool { return (state >> 24) & 1u; }
+
+// Where a piece of debris is, to draw its pixels as quads turned with it
+struct debris_snapshot
+{
+    glm::vec2                                        position; // Of the body's origin
+    float                                            angle;
+    std::shared_ptr<const std::vector<debris_pixel>> pixels;
+};
+
+struct snapshot_options
+{
+    bool everything = false; // Every chunk rather than just what changed
+    bool scanned    = false; // Every resident chunk, marking the pixels scanned last tick
+    bool colliders  = false; // The outlines of the static colliders
+    bool telemetry  = false; // What each chunk cost last tick
+
+    // The chunks in view, inclusive. Chunks outside it are left out and keep what they
+    // have to redraw until they come into view.
+    glm::ivec2 view_min = {0, 0};
+    glm::ivec2 view_max = {std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
+};
+
+// An immutable copy of everything the frontend draws or shows about a world, so it can be
+// read on another thread while the simulation carries on.
+struct world_snapshot
+{
+    std::size_t                 width;
+    std::size_t                 height;
+    std::uint64_t               tick;
+    bool                        everything;
+    std::vector<chunk_snapshot> chunks; // At most one per chunk
+
+    // By chunk, only if asked for. Each outline is shared with the world until the chunk's
+    // collider changes, so an unchanged one is the same object from snapshot to snapshot.
+    std::vector<std::shared_ptr<const collider_outline>> collider_outlines;
+
+    std::vector<debris_snapshot> debris;
+
+    // By chunk, only if asked for. Chunks that did nothing last tick have empty stats.
+    std::vector<chunk_stats> telemetry;
+
+    glm::vec2     player_centre;
+    float         player_radius;
+    glm::ivec2    spawn_point;
+    collider_mode colliders;
+    bool          level_liquids;
+    bool          deterministic;
+    int           num_fixtures;
+    int           num_proxies;
+    std::size_t   enabled_chunk_bodies;
+    std::size_t   awake_chunks;
+    std::size_t   resident_pages;
+    std::size_t   paged_out;
+
+    std::optional<std::size_t> recorded_ticks; // Set by the simulation while recording
+};
+
+// Copies out the regions of each chunk due to be redrawn, clearing them
+auto take_snapshot(world& w, const snapshot_options& options) -> std::unique_ptr<world_snapshot>;
+
+// Marks the regions of a snapshot that was never drawn to be redrawn again, so the next
+// snapshot taken includes them
+auto return_snapshot(world& w, const world_snapshot& unread) -> void;
+
+}
@@ -0,0 +1,83 @@
+#include "thread_pool.hpp"
+
+#include <cassert>
+
+namespace sand {
+
+thread_pool::thread_pool(std::size_t num_threads)
+{
+    assert(num_threads > 0);
+    d_workers.reserve(num_threads - 1);
+    for (std::size_t i = 1; i < num_threads; ++i) {
+        d_workers.emplace_back([this] { worker_loop(); });
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        const auto lock = std::scoped_lock{d_mutex};
+        d_stopping = true;
+    }
+    d_job_ready.notify_all();
+    d_workers.clear(); // joins the workers before the rest of the pool is destroyed
+}
+
+auto thread_pool::worker_loop() -> void
+{
+    auto seen_generation = std::size_t{0};
+    while (true) {
+        {
+            auto lock = std::unique_lock{d_mutex};
+            d_job_ready.wait(lock, [&] {
+                return d_stopping || d_generation != seen_generation;
+            });
+            if (d_stopping) return;
+            seen_generation = d_generation;
+        }
+
+        run_job();
+
+        const auto lock = std::scoped_lock{d_mutex};
+        if (--d_busy == 0) {
+            d_job_done.notify_one();
+        }
+    }
+}
+
+auto thread_pool::run_job() -> void
+{
+    while (true) {
+        const auto index = d_next_index.fetch_add(1, std::memory_order_relaxed);
+        if (index >= d_job_size) return;
+        (*d_job)(index);
+    }
+}
+
+auto thread_pool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& func) -> void
+{
+    if (d_workers.empty() || count <= 1) {
+        for (std::size_t i = 0; i != count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    {
+        const auto lock = std::scoped_lock{d_mutex};
+        d_job = &func;
+        d_job_size = count;
+        d_next_index = 0;
+        d_busy = d_workers.size();
+        ++d_generation;
+    }
+    d_job_ready.notify_all();
+
+    run_job();
+
+    auto lock = std::unique_lock{d_mutex};
+    d_job_done.wait(lock, [&] { return d_busy == 0; });
+    d_job = nullptr;
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sand {
+
+// A fixed set of worker threads for running data parallel loops. The calling thread
+// also takes part in each loop, so a pool with one thread runs everything inline.
+class thread_pool
+{
+    std::mutex              d_mutex;
+    std::condition_variable d_job_ready;
+    std::condition_variable d_job_done;
+
+    const std::function<void(std::size_t)>* d_job = nullptr;
+    std::size_t              d_job_size   = 0;
+    std::atomic<std::size_t> d_next_index = 0;
+    std::size_t              d_generation = 0; // Bumped every time a new job is posted
+    std::size_t              d_busy       = 0; // Workers that have not finished the current job
+    bool                     d_stopping   = false;
+
+    std::vector<std::jthread> d_workers;
+
+    auto worker_loop() -> void;
+    auto run_job() -> void;
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+public:
+    explicit thread_pool(std::size_t num_threads);
+    ~thread_pool();
+
+    auto num_threads() const -> std::size_t { return d_workers.size() + 1; }
+
+    // Calls func(i) for each i in [0, count), spread across the pool. Indices are handed
+    // out in increasing order. Blocks until every call has returned.
+    auto parallel_for(std::size_t count, const std::function<void(std::size_t)>& func) -> void;
+};
+
+}
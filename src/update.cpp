@@ -4,14 +4,24 @@
 #include "explosion.hpp"
 #include "world.hpp"
 #include "update_rigid_bodies.hpp"
+#include "update_liquids.hpp"
+#include "debris.hpp"
+#include "thread_pool.hpp"
+#include "profiler.hpp"
+#include "scratch.hpp"
 
 #include <array>
+#include <cassert>
+#include <bit>
+#include <memory_resource>
+#include <optional>
 #include <utility>
 #include <variant>
 #include <print>
 #include <algorithm>
 #include <random>
 #include <ranges>
+#include <tuple>
 
 #include <glm/glm.hpp>
 #include <glm/gtx/norm.hpp>
@@ -30,13 +40,19 @@ static constexpr auto neighbour_offsets = std::array{
     glm::ivec2{1, -1}
 };
 
-static constexpr auto adjacent_offsets = std::array{
-    glm::ivec2{1, 0},
-    glm::ivec2{-1, 0},
-    glm::ivec2{0, 1},
-    glm::ivec2{0, -1}
+// Each type is updated by a version of update_pixel compiled for the behaviour it has,
+// so that inert powders never evaluate the fire or acid branches. Burning is a flag that
+// explosions can give any pixel, so it is still checked in every kernel. Electricity is
+// handled by the circuit_network.
+enum kernel_bits : std::uint8_t
+{
+    kernel_moves   = 1 << 0, // Has gravity, dispersion or diagonal movement
+    kernel_reacts  = 1 << 1, // Boils, corrodes, ignites or produces embers in neighbours
+    kernel_decays  = 1 << 2, // Can be spontaneously destroyed
 };
 
+static constexpr auto num_kernels = std::size_t{8};
+
 auto can_pixel_move_to(const world& w, glm::ivec2 src_pos, glm::ivec2 dst_pos) -> bool
 {
     if (!w.pixels.valid(src_pos) || !w.pixels.valid(dst_pos)) { return false; }
@@ -44,8 +60,8 @@ auto can_pixel_move_to(const world& w, glm::ivec2 src_pos, glm::ivec2 dst_pos) -
     // If the destination is empty, we can always move there
     if (w.pixels[dst_pos].type == pixel_type::none) { return true; }
 
-    const auto src = properties(w.pixels[src_pos]).phase;
-    const auto dst = properties(w.pixels[dst_pos]).phase;
+    const auto src = hot_properties(w.pixels[src_pos].type).phase;
+    const auto dst = hot_properties(w.pixels[dst_pos].type).phase;
 
     using pm = pixel_phase;
     switch (src) {
@@ -61,58 +77,128 @@ auto can_pixel_move_to(const world& w, glm::ivec2 src_pos, glm::ivec2 dst_pos) -
     }
 }
 
-auto set_adjacent_free_falling(world& w, glm::ivec2 pos) -> void
+// The pixels woken while updating a chunk. Rather than growing the dirty rects of the
+// chunks around it for every pixel moved, they are gathered into a bitboard per chunk and
+// the rects are grown once when the chunk is done. Pixels never get further than
+// config::max_pixel_move from the chunk being updated, so only it and the chunks next to
+// it can be woken. It also counts what the update of the chunk did, for its chunk_stats.
+class wake_mask
+{
+    world&                        d_world;
+    glm::ivec2                    d_origin; // The top left pixel of the chunks around
+    std::array<chunk_bitboard, 9> d_boards = {};
+    std::uint32_t                 d_touched = 0;
+
+public:
+    std::uint32_t pixels = 0;
+    std::uint32_t moves  = 0;
+    std::uint32_t wakes  = 0;
+
+    wake_mask(world& w, std::size_t index)
+        : d_world{w}
+        , d_origin{config::chunk_size * (get_chunk_pos(w, index) - 1)}
+    {}
+
+    auto wake(glm::ivec2 pixel) -> void
+    {
+        assert(d_world.pixels.valid(pixel));
+        const auto offset = pixel - d_origin;
+        const auto chunk = offset / config::chunk_size;
+        const auto local = offset % config::chunk_size;
+        assert(0 <= chunk.x && chunk.x < 3 && 0 <= chunk.y && chunk.y < 3);
+        const auto slot = 3 * chunk.y + chunk.x;
+        d_boards[slot].rows[local.y] |= std::uint64_t{1} << local.x;
+        d_touched |= 1u << slot;
+        ++wakes;
+    }
+
+    // Wakes the bounding rect of the pixels woken in each chunk, which is what waking
+    // them one at a time would have grown the rects to
+    auto apply() -> void
+    {
+        for (auto touched = d_touched; touched; touched &= touched - 1) {
+            const auto slot = std::countr_zero(touched);
+            const auto& board = d_boards[slot];
+            auto min_y = config::chunk_size;
+            auto max_y = -1;
+            auto columns = std::uint64_t{0};
+            for (int y = 0; y != config::chunk_size; ++y) {
+                if (!board.rows[y]) continue;
+                min_y = std::min(min_y, y);
+                max_y = y;
+                columns |= board.rows[y];
+            }
+            const auto top_left = d_origin + config::chunk_size * glm::ivec2{slot % 3, slot / 3};
+            d_world.wake_region(
+                top_left + glm::ivec2{std::countr_zero(columns), min_y},
+                top_left + glm::ivec2{63 - std::countl_zero(columns), max_y}
+            );
+        }
+        d_touched = 0;
+    }
+};
+
+auto set_adjacent_free_falling(world& w, wake_mask& wakes, glm::ivec2 pos) -> void
 {
     const auto l = pos + glm::ivec2{-1, 0};
     const auto r = pos + glm::ivec2{1, 0};
 
     for (const auto x : {l, r}) {
         if (w.pixels.valid(x)) {
-            auto& px = w.pixels[x];
-            const auto& props = properties(px);
-            if (props.gravity_factor != 0.0f) {
-                w.wake_chunk_with_pixel(l);
-                if (random_unit() > props.inertial_resistance) px.flags[is_falling] = true;
+            const auto type = std::as_const(w.pixels)[x].type;
+            if (hot_properties(type).gravity_factor != 0.0f) {
+                wakes.wake(x);
+                if (random_unit() > properties(type).inertial_resistance) w.pixels[x].flags[is_falling] = true;
             }
         }
     }
 }
 
 // Moves towards the given offset, updating pos to the new postion and returning
-// true if the position has changed
-auto move_offset(world& pixels, glm::ivec2& pos, glm::ivec2 offset) -> bool
+// true if the position has changed. The whole path is checked first and the pixel is then
+// moved once, with whatever it displaces from the end of the path taking its place.
+auto move_offset(world& w, wake_mask& wakes, glm::ivec2& pos, glm::ivec2 offset) -> bool
 {
-    glm::ivec2 start_pos = pos;
-
     const auto a = pos;
-    const auto b = pos + offset;
+    const auto b = pos + glm::clamp(offset, -config::max_pixel_move, config::max_pixel_move);
     const auto steps = glm::max(glm::abs(a.x - b.x), glm::abs(a.y - b.y));
 
+    auto end = a;
     for (int i = 0; i != steps; ++i) {
         const auto next_pos = a + (b - a) * (i + 1)/steps;
-
-        if (!can_pixel_move_to(pixels, pos, next_pos)) {
+        if (!can_pixel_move_to(w, a, next_pos)) {
             break;
         }
-
-        pixels.wake_chunk_with_pixel(pos);
-        pixels.wake_chunk_with_pixel(next_pos);
-        std::swap(pixels.pixels[pos], pixels.pixels[next_pos]);
-        pos = next_pos;
-        set_adjacent_free_falling(pixels, pos);
+        end = next_pos;
+        set_adjacent_free_falling(w, wakes, end);
     }
 
-    if (start_pos != pos) {
-        pixels.pixels[pos].flags[is_falling] = true;
-        pixels.wake_chunk_with_pixel(pos);
-        return true;
+    if (end == a) {
+        return false;
     }
 
-    return false;
+    w.pixels.swap(a, end);
+    w.pixels[end].flags[is_falling] = true;
+    ++wakes.moves;
+    wakes.wake(a);
+    wakes.wake(end);
+    pos = end;
+    return true;
 }
 
 auto is_surrounded(const world& w, glm::ivec2 pos) -> bool
-{ 
+{
+    // Away from the chunk edges the neighbours are a few bits in three rows of a bitboard
+    const auto local = pos % config::chunk_size;
+    if (0 < local.x && local.x < config::chunk_size - 1 && 0 < local.y && local.y < config::chunk_size - 1) {
+        const auto& occupied = w.pixels.bitboards(pos).occupied;
+        const auto outer = std::uint64_t{0b111} << (local.x - 1);
+        const auto sides = std::uint64_t{0b101} << (local.x - 1);
+        return (occupied.row(local.y - 1) & outer) == outer
+            && (occupied.row(local.y) & sides) == sides
+            && (occupied.row(local.y + 1) & outer) == outer;
+    }
+
     for (const auto& offset : neighbour_offsets) {
         if (w.pixels.valid(pos + offset)) {
             if (w.pixels[pos + offset].type == pixel_type::none) {
@@ -130,17 +216,36 @@ auto sign(float f) -> int
     return 0;
 }
 
-inline auto update_pixel_position(world& pixels, glm::ivec2& pos) -> void
+// How far along the row in the given direction the pixel could move and then fall, or 0
+// if it can't within the range
+auto distance_to_drop(const world& w, glm::ivec2 pos, int dir, int range) -> int
 {
+    const auto down = glm::ivec2{0, sign(hot_properties(w.pixels[pos].type).gravity_factor)};
+    if (down.y == 0) return 0;
+    for (int i = 1; i <= std::min(range, config::max_pixel_move); ++i) {
+        const auto next = pos + glm::ivec2{dir * i, 0};
+        if (!can_pixel_move_to(w, pos, next)) return 0;
+        if (can_pixel_move_to(w, pos, next + down)) return i;
+    }
+    return 0;
+}
+
+template <std::uint8_t Kernel>
+inline auto update_pixel_position(world& pixels, wake_mask& wakes, glm::ivec2& pos) -> void
+{
+    if constexpr (!(Kernel & kernel_moves)) {
+        pixels.pixels[pos].flags[is_falling] = false;
+        return;
+    }
     const auto start_pos = pos;
 
-    auto& data = pixels.pixels[pos];
-    const auto& props = properties(data);
+    auto data = pixels.pixels[pos];
+    const auto& props = properties(data.type);
 
     // Pixels that don't move have their is_falling flag set to false at the end
     const auto after_position_update = scope_exit{[&] {
         pixels.pixels[pos].flags[is_falling] = pos != start_pos;
-        if (pos == start_pos && properties(pixels.pixels[pos]).gravity_factor) {
+        if (pos == start_pos && hot_properties(pixels.pixels[pos].type).gravity_factor) {
             pixels.pixels[pos].velocity = glm::ivec2{0, 1}; // will always try to move at least one block
         }
     }};
@@ -149,7 +254,7 @@ inline auto update_pixel_position(world& pixels, glm::ivec2& pos) -> void
     if (props.gravity_factor) {
         const auto gravity_factor = props.gravity_factor;
         data.velocity += gravity_factor * config::gravity * config::time_step;
-        if (move_offset(pixels, pos, data.velocity)) return;
+        if (move_offset(pixels, wakes, pos, data.velocity)) return;
     }
 
     // If we have resistance to moving and we are not, then we are not moving
@@ -164,7 +269,7 @@ inline auto update_pixel_position(world& pixels, glm::ivec2& pos) -> void
         if (coin_flip()) std::swap(offsets[0], offsets[1]);
 
         for (auto offset : offsets) {
-            if (move_offset(pixels, pos, offset)) return;
+            if (move_offset(pixels, wakes, pos, offset)) return;
         }
     }
 
@@ -175,57 +280,35 @@ inline auto update_pixel_position(world& pixels, glm::ivec2& pos) -> void
         auto offsets = std::array{glm::ivec2{-dr, 0}, glm::ivec2{dr, 0}};
         if (coin_flip()) std::swap(offsets[0], offsets[1]);
 
-        for (auto offset : offsets) {
-            if (move_offset(pixels, pos, offset)) return;
+        // Levelled liquids only spread towards somewhere they can fall, the nearest first,
+        // so a pixel on a flat surface comes to rest rather than wandering across it
+        if (pixels.level_liquids && props.phase == pixel_phase::liquid) {
+            auto best = 0;
+            for (auto offset : offsets) {
+                const auto distance = distance_to_drop(pixels, pos, sign(offset.x), dr);
+                if (distance && (!best || distance < std::abs(best))) {
+                    best = sign(offset.x) * distance;
+                }
+            }
+            if (best) move_offset(pixels, wakes, pos, {best, 0});
+            return;
         }
-    }
-}
-
-// Determines if the pixel at the given offset should power the current position.
-// offset must be a unit vector.
-auto should_get_powered(const world& w, glm::ivec2 pos, glm::ivec2 offset) -> bool
-{
-    const auto& src = w.pixels[pos + offset];
-    const auto& dst = w.pixels[pos];
 
-    // Prevents current from flowing from diode_out to diode_in
-    if (dst.type == pixel_type::diode_in && src.type == pixel_type::diode_out) {
-        return false;
-    }
-
-    // diode_out can *only* be powered by diode_in and itself
-    if (dst.type == pixel_type::diode_out && src.type != pixel_type::diode_in
-                                          && src.type != pixel_type::diode_out) {
-        return false;
-    }
-
-    // If the neighbour is a relay, we need to jump over it and check the pixel on the
-    // other side.
-    if (src.type == pixel_type::relay) {
-        auto new_pos = pos + 2 * offset;
-        if (!w.pixels.valid(new_pos)) return false;
-        const auto& new_src = w.pixels[new_pos];
-        const auto& props = properties(new_src);
-        return is_active_power_source(new_src)
-            || ((props.power_max) / 2 < new_src.power && new_src.power < props.power_max);
+        for (auto offset : offsets) {
+            if (move_offset(pixels, wakes, pos, offset)) return;
+        }
     }
-
-    // dst can get powered if src is either a power source or powered. Excludes the
-    // maximum power level so electricity can only flow one block per tick.
-    const auto& props = properties(src);
-    return is_active_power_source(src)
-        || ((props.power_max) / 2 < src.power && src.power < props.power_max);
 }
 
 // Update logic for single pixels depending on properties only
-inline auto update_pixel_attributes(world& w, glm::ivec2 pos) -> void
+template <std::uint8_t Kernel>
+inline auto update_pixel_attributes(world& w, wake_mask& wakes, glm::ivec2 pos) -> void
 {
-    auto& pixel = w.pixels[pos];
-    const auto& props = properties(pixel);
+    auto pixel = w.pixels[pos];
+    const auto& props = properties(pixel.type);
 
-    if (pixel.flags[is_burning] || props.always_awake) {
-        w.wake_chunk_with_pixel(pos);
-    }
+    // Burning and always awake pixels are ticked every step, see tick_pixels, so they only
+    // wake their surroundings when they change them
 
     // is_burning status
     if (pixel.flags[is_burning]) {
@@ -239,95 +322,59 @@ inline auto update_pixel_attributes(world& w, glm::ivec2 pos) -> void
         // See if it gets destroyed
         if (random_unit() < props.burn_out_chance) {
             pixel = pixel::air();
+            wakes.wake(pos);
         }
 
         // See if it explodes
         if (random_unit() < props.explosion_chance) {
-            apply_explosion(w, pos, sand::explosion{
+            w.queue_explosion(pos, sand::explosion{
                 .min_radius = 5.0f, .max_radius = 10.0f, .scorch = 5.0f
             });
         }
 
     }
 
-    // Electricity
-    switch (props.power_type) {
-        case pixel_power_type::conductor: {
-            if (pixel.power > 0) {
-                --pixel.power;
-            }
-
-            // Check to see if we should power up just before we hit zero in order to
-            // maintain a current
-            if (pixel.power <= 1) {
-                for (const auto& offset : adjacent_offsets) {
-                    if (!w.pixels.valid(pos + offset)) continue;
-                    auto& neighbour = w.pixels[pos + offset];
-
-                    if (should_get_powered(w, pos, offset)) {
-                        pixel.power = props.power_max;
-                        break;
-                    }
-                }
-            }
-
-            if (pixel.power > 0 && props.explodes_on_power) {
-                apply_explosion(w, pos, sand::explosion{
-                    .min_radius = 25.0f, .max_radius = 30.0f, .scorch = 10.0f
-                });
-            }
-        } break;
-
-        case pixel_power_type::source: {
-            if (pixel.power < props.power_max) {
-                ++pixel.power;
-            }
-            for (const auto& offset : adjacent_offsets) {
-                if (!w.pixels.valid(pos + offset)) continue;
-                auto& neighbour = w.pixels[pos + offset];
-
-                // Powered diode_offs disable power sources
-                if (neighbour.type == pixel_type::diode_out && neighbour.power > 0) {
-                    pixel.power = 0;
-                    break;
-                }
-            }
-        } break;
-
-        case pixel_power_type::none: {} break;
-    }
-
-    if (pixel.power > 0) {
-        w.wake_chunk_with_pixel(pos);
-    }
-
-    if (random_unit() < props.spontaneous_destroy) {
-        w.pixels[pos] = pixel::air();
+    if constexpr (Kernel & kernel_decays) {
+        if (random_unit() < props.spontaneous_destroy) {
+            w.pixels[pos] = pixel::air();
+            wakes.wake(pos);
+        }
     }
 }
 
-inline auto update_pixel_neighbours(world& w, glm::ivec2 pos) -> void
+template <std::uint8_t Kernel>
+inline auto update_pixel_neighbours(world& w, wake_mask& wakes, glm::ivec2 pos) -> void
 {
-    auto& pixel = w.pixels[pos];
-    const auto& props = properties(pixel);
+    auto pixel = w.pixels[pos];
+    static constexpr auto reacts = (Kernel & kernel_reacts) != 0;
+    if (!reacts && !pixel.flags[is_burning]) {
+        return;
+    }
+    const auto& props = properties(pixel.type);
 
-    // Affect adjacent neighbours as well as diagonals
+    // Affect adjacent neighbours as well as diagonals. Neighbours are read through the const
+    // pixels and only written when they change, so a neighbouring chunk that was never
+    // written to keeps sharing the page of air.
     for (const auto& offset : neighbour_offsets) {
         if (!w.pixels.valid(pos + offset)) continue;             
         const auto neigh_pos = pos + offset;
-        auto& neighbour = w.pixels[neigh_pos];
+        const auto neighbour = std::as_const(w.pixels)[neigh_pos];
 
         // Boil water
-        if (props.can_boil_water) {
+        if (reacts && props.can_boil_water) {
             if (neighbour.type == pixel_type::water) {
-                neighbour = pixel::steam();
+                w.pixels[neigh_pos] = pixel::steam();
+                wakes.wake(neigh_pos);
             }
         }
 
         // Corrode neighbours
-        if (props.is_corrosion_source) {
-            if (random_unit() > properties(neighbour).corrosion_resist) {
-                neighbour = pixel::air();
+        if (reacts && props.is_corrosion_source) {
+            if (random_unit() > properties(neighbour.type).corrosion_resist) {
+                if (neighbour.type != pixel_type::none) {
+                    w.pixels[neigh_pos] = pixel::air();
+                }
+                wakes.wake(neigh_pos);
                 if (random_unit() > 0.9f) {
                     pixel = pixel::air();
                 }
@@ -335,70 +382,329 @@ inline auto update_pixel_neighbours(world& w, glm::ivec2 pos) -> void
         }
         
         // Spread fire
-        if (props.is_burn_source || pixel.flags[is_burning]) {
-            if (random_unit() < properties(neighbour).flammability) {
-                neighbour.flags[is_burning] = true;
-                w.wake_chunk_with_pixel(neigh_pos);
+        if ((reacts && props.is_burn_source) || pixel.flags[is_burning]) {
+            if (!neighbour.flags[is_burning] && random_unit() < properties(neighbour.type).flammability) {
+                w.pixels[neigh_pos].flags[is_burning] = true;
+                wakes.wake(neigh_pos);
             }
         }
 
         // Produce embers
-        const bool can_produce_embers = props.is_ember_source || pixel.flags[is_burning];
+        const bool can_produce_embers = (reacts && props.is_ember_source) || pixel.flags[is_burning];
         if (can_produce_embers && neighbour.type == pixel_type::none) {
             if (random_unit() < 0.01f) {
                 w.pixels[neigh_pos] = pixel::ember();
-                w.wake_chunk_with_pixel(neigh_pos);
+                wakes.wake(neigh_pos);
             }
         }
     }
 }
 
-auto update_pixel(world& pixels, glm::ivec2 pos) -> void
+template <std::uint8_t Kernel>
+auto update_pixel_kernel(world& w, wake_mask& wakes, glm::ivec2 pos) -> void
+{
+    update_pixel_position<Kernel>(w, wakes, pos);
+    update_pixel_neighbours<Kernel>(w, wakes, pos);
+    update_pixel_attributes<Kernel>(w, wakes, pos);
+
+    w.pixels[pos].flags[is_updated] = true;
+}
+
+using pixel_kernel = void(*)(world&, wake_mask&, glm::ivec2);
+
+template <std::size_t... Kernels>
+constexpr auto make_kernels(std::index_sequence<Kernels...>) -> std::array<pixel_kernel, num_kernels>
+{
+    return {&update_pixel_kernel<static_cast<std::uint8_t>(Kernels)>...};
+}
+
+static constexpr auto kernels = make_kernels(std::make_index_sequence<num_kernels>{});
+
+auto kernel_bits_for(pixel_type type) -> std::uint8_t
+{
+    const auto& props = properties(type);
+    auto bits = std::uint8_t{0};
+    if (props.gravity_factor != 0.0f || props.can_move_diagonally || props.dispersion_rate != 0) {
+        bits |= kernel_moves;
+    }
+    if (props.can_boil_water || props.is_corrosion_source || props.is_burn_source || props.is_ember_source) {
+        bits |= kernel_reacts;
+    }
+    if (props.spontaneous_destroy > 0.0f) {
+        bits |= kernel_decays;
+    }
+    return bits;
+}
+
+const auto type_kernels = [] {
+    auto table = std::array<pixel_kernel, num_pixel_types>{};
+    for (std::size_t i = 0; i != num_pixel_types; ++i) {
+        table[i] = kernels[kernel_bits_for(static_cast<pixel_type>(i))];
+    }
+    return table;
+}();
+
+auto update_pixel(world& pixels, wake_mask& wakes, glm::ivec2 pos) -> void
 {
-    if (pixels.pixels[pos].type == pixel_type::none || pixels.pixels[pos].flags[is_updated]) {
+    const auto type = pixels.pixels[pos].type;
+    if (type == pixel_type::none || pixels.pixels[pos].flags[is_updated]) {
         return;
     }
+    ++wakes.pixels;
+    type_kernels[static_cast<std::size_t>(type)](pixels, wakes, pos);
+}
 
-    update_pixel_position(pixels, pos);
-    update_pixel_neighbours(pixels, pos);
-    update_pixel_attributes(pixels, pos);
+// Moves the rect woken last step into place, returning true if there is anything to scan.
+// Chunks are often woken by pixels moving past their edge, and a rect with no pixels in it
+// and no collider to take down would only scan air, so the chunk goes straight back to sleep.
+auto prepare_chunk(world& w, std::size_t index) -> bool
+{
+    auto& c = w.chunks[index];
+    c.dirty = std::exchange(c.dirty_next, chunk_rect{});
+    w.awake.reset(index);
+    if (c.should_step() && !w.pixels.bitboards(index).occupied.any(c.dirty) && !c.static_pixels.any(c.dirty)) {
+        c.dirty = chunk_rect{};
+    }
+    if (c.should_step()) {
+        w.stepping.set(index);
+    }
+    return c.should_step() || w.ticking.test(index);
+}
 
-    pixels.pixels[pos].flags[is_updated] = true;
+// The next chunk below end with anything to update
+auto find_last_active(const world& w, std::size_t end) -> std::size_t
+{
+    const auto awake = w.awake.find_last(end);
+    const auto ticking = w.ticking.find_last(end);
+    if (awake == chunk_bitset::npos) return ticking;
+    if (ticking == chunk_bitset::npos) return awake;
+    return std::max(awake, ticking);
 }
 
+auto ticking_row(const chunk_bitboards& boards, int y) -> std::uint64_t
+{
+    return (boards.flags[is_burning].row(y) | boards.awake_types.row(y)) & ~boards.flags[is_updated].row(y);
 }
 
-auto update(world& w) -> void
+// Updates the burning and always awake pixels that the scan of the dirty rect didn't reach.
+// These are found from the bitboards, so a chunk with only a few of them costs a few row
+// reads rather than a scan. They flicker, so they are always redrawn.
+auto tick_pixels(world& w, wake_mask& wakes, std::size_t index) -> void
 {
-    for (auto& pixel : w.pixels) {
-        pixel.flags[is_updated] = false;
-    }
-    
-    for (auto it = w.chunks.rbegin(); it != w.chunks.rend(); ++it) {
-        auto& chunk = *it;
-        chunk.should_step = std::exchange(chunk.should_step_next, false);
-        if (!chunk.should_step) continue;
-    
-        const auto index = w.chunks.size() - std::distance(w.chunks.rbegin(), it) - 1;
-        const auto top_left = sand::config::chunk_size * get_chunk_pos(w, index);
-        for (int y = sand::config::chunk_size; y != 0; --y) {
-            if (coin_flip()) {
-                for (int x = 0; x != sand::config::chunk_size; ++x) {
-                    const auto pos = top_left + glm::ivec2{x, y - 1};
-                    update_pixel(w, pos);
-                }
+    const auto top_left = sand::config::chunk_size * get_chunk_pos(w, index);
+    const auto& boards = w.pixels.bitboards(index);
+
+    auto redraw = chunk_rect{};
+    for (int y = sand::config::chunk_size - 1; y >= 0; --y) {
+        // Reread after each pixel, since updating one can move or put out the others
+        auto done = std::uint64_t{0};
+        while (const auto bits = ticking_row(boards, y) & ~done) {
+            const auto x = std::countr_zero(bits);
+            done |= std::uint64_t{1} << x;
+            redraw = merge(redraw, chunk_rect{{x, y}, {x, y}});
+            update_pixel(w, wakes, top_left + glm::ivec2{x, y});
+        }
+    }
+    if (!redraw.empty()) {
+        w.chunks[index].redraw = merge(w.chunks[index].redraw, redraw);
+        w.unsaved.set(index);
+    }
+}
+
+// Chunks stepped last tick that nothing has woken since go back to sleep here, since only
+// awake chunks get prepared
+auto settle_sleeping_chunks(world& w) -> void
+{
+    for (auto index = w.stepping.find_last(w.chunks.size()); index != chunk_bitset::npos; index = w.stepping.find_last(index)) {
+        if (!w.awake.test(index)) {
+            w.chunks[index].dirty = chunk_rect{};
+        }
+    }
+    w.stepping.clear();
+}
+
+// Gives each chunk its own stream in deterministic mode. The stream after the last chunk
+// is used for applying the explosions of the tick.
+auto seed_random(const world& w, std::size_t stream) -> void
+{
+    if (w.seed) {
+        random_seed(*w.seed ^ std::rotl(w.tick, 32) ^ stream);
+    }
+}
+
+// Only the dirty rect is scanned, so a few moving pixels don't cost a whole chunk. Air is
+// never updated, so the scan jumps between occupied pixels using the occupancy bitboard
+// and empty rows cost a single test. The row is reread after each pixel since updating
+// one can fill or empty the others.
+auto update_chunk(world& w, std::size_t index) -> void
+{
+    const auto zone = profile_zone{"update_chunk"};
+    seed_random(w, index);
+    const auto draws = random_draws();
+
+    static_assert(sand::config::chunk_size <= 64, "one random bit per row");
+    auto row_flips = random_bits();
+
+    const auto top_left = sand::config::chunk_size * get_chunk_pos(w, index);
+    const auto rect = w.chunks[index].dirty;
+    const auto columns = rect.columns();
+    const auto& occupied = w.pixels.bitboards(index).occupied;
+    const auto all = ~std::uint64_t{0};
+    auto wakes = wake_mask{w, index};
+
+    for (int y = rect.max.y; y >= rect.min.y; --y, row_flips >>= 1) {
+        if (!(occupied.row(y) & columns)) continue;
+
+        if (row_flips & 1) {
+            for (int x = rect.min.x; x <= rect.max.x; ++x) {
+                const auto remaining = occupied.row(y) & columns & (all << x);
+                if (!remaining) break;
+                x = std::countr_zero(remaining);
+                update_pixel(w, wakes, top_left + glm::ivec2{x, y});
             }
-            else {
-                for (int x = sand::config::chunk_size; x != 0; --x) {
-                    const auto pos = top_left + glm::ivec2{x - 1, y - 1};
-                    update_pixel(w, pos);
-                }
+        }
+        else {
+            for (int x = rect.max.x; x >= rect.min.x; --x) {
+                const auto remaining = occupied.row(y) & columns & (all >> (63 - x));
+                if (!remaining) break;
+                x = 63 - std::countl_zero(remaining);
+                update_pixel(w, wakes, top_left + glm::ivec2{x, y});
+            }
+        }
+    }
+    tick_pixels(w, wakes, index);
+    wakes.apply();
+
+    auto& stats = w.chunks[index].stats.begin(w.tick);
+    stats.pixels += wakes.pixels;
+    stats.moves += wakes.moves;
+    stats.wakes += wakes.wakes;
+    stats.random_draws += static_cast<std::uint32_t>(random_draws() - draws);
+}
+
+// Everything set off during the tick is resolved together in one batch, so chain reactions
+// of overlapping blasts write each pixel once
+auto apply_queued_explosions(world& w) -> void
+{
+    if (w.queued_explosions.empty()) return;
+    const auto zone = profile_zone{"apply_queued_explosions"};
+    seed_random(w, w.chunks.size());
+
+    // Workers queue in whatever order they finish, so sort to keep the result reproducible
+    std::ranges::sort(w.queued_explosions, [](const auto& a, const auto& b) {
+        const auto key = [](const auto& e) {
+            return std::tie(e.first.y, e.first.x, e.second.min_radius, e.second.max_radius, e.second.scorch);
+        };
+        return key(a) < key(b);
+    });
+    apply_explosions(w, w.queued_explosions);
+    w.queued_explosions.clear();
+}
+
+// Both schedulers leave the indices of the chunks they stepped in stepped. They visit the
+// chunks in different orders, so only update_parallel is used in deterministic mode, where
+// a pool with one thread runs the same passes inline.
+auto update_serial(world& w, std::pmr::vector<std::size_t>& stepped) -> void
+{
+    // Chunks woken below the one being updated are found as the scan reaches them
+    for (auto index = find_last_active(w, w.chunks.size()); index != chunk_bitset::npos; index = find_last_active(w, index)) {
+        if (!prepare_chunk(w, index)) continue;
+        update_chunk(w, index);
+        stepped.push_back(index);
+    }
+}
+
+// Chunks are split into four passes by the parity of their coordinates. Chunks within a
+// pass are at least one chunk apart, and since pixels never move further than
+// config::max_pixel_move in a step, they never read or write the same pixels. Each pass
+// is handed to the pool bottom row first, and every chunk is still scanned bottom to top.
+auto update_parallel(world& w, thread_pool& pool, std::pmr::vector<std::size_t>& stepped) -> void
+{
+    static constexpr auto passes = std::array{
+        glm::ivec2{0, 1}, glm::ivec2{1, 1}, glm::ivec2{0, 0}, glm::ivec2{1, 0}
+    };
+
+    auto to_update = std::pmr::vector<std::size_t>{stepped.get_allocator()};
+
+    for (std::size_t pass = 0; pass != passes.size(); ++pass) {
+        const auto parity = passes[pass];
+        to_update.clear();
+        for (auto index = find_last_active(w, w.chunks.size()); index != chunk_bitset::npos; index = find_last_active(w, index)) {
+            const auto chunk_pos = get_chunk_pos(w, index);
+            if (chunk_pos.x % 2 != parity.x || chunk_pos.y % 2 != parity.y) continue;
+
+            if (prepare_chunk(w, index)) {
+                to_update.push_back(index);
             }
         }
-        create_chunk_triangles(w, chunk, top_left);
+
+        pool.parallel_for(to_update.size(), [&](std::size_t i) {
+            update_chunk(w, to_update[i]);
+        });
+
+        stepped.insert(stepped.end(), to_update.begin(), to_update.end());
+    }
+}
+
+}
+
+auto update(world& w, thread_pool& pool) -> void
+{
+    const auto zone = profile_zone{"update"};
+
+    // The per tick lists come from the scratch arena, which is reset by the next scope
+    const auto scope = scratch_scope{w.scratch_epoch};
+    auto& scratch = scratch_arena::for_this_thread(w.scratch_epoch);
+    auto stepped = std::pmr::vector<std::size_t>{&scratch};
+    settle_sleeping_chunks(w);
+    if (pool.num_threads() == 1 && !w.seed) {
+        update_serial(w, stepped);
+    } else {
+        update_parallel(w, pool, stepped);
     }
-    
-    w.physics.Step(sand::config::time_step, 8, 3);
+
+    w.circuits.step(w);
+    apply_queued_explosions(w);
+
+    // Levelling only moves pixels within each chunk, so every stepped chunk can be done at once
+    if (w.level_liquids) {
+        pool.parallel_for(stepped.size(), [&](std::size_t i) {
+            level_liquids(w, stepped[i]);
+        });
+    }
+
+    // Colliders are rebuilt once the pixels are settled for the tick, by update_physics at
+    // the end. Chunks changed by explosions without being stepped were woken and catch up
+    // when they are stepped next tick.
+    std::ranges::sort(stepped, std::greater{});
+
+    // Pixels only get marked as updated in the chunks that were updated, or that they moved
+    // into, which were woken, so those are the only ones to clear for the next tick. There
+    // can be several ticks per frame so the rects are also gathered up for the renderer.
+    // Pixels only start burning or appear in chunks that were updated or woken, so these
+    // are also the only chunks that can start or stop ticking.
+    const auto settle = [&](std::size_t index) {
+        auto& c = w.chunks[index];
+        const auto& boards = w.pixels.bitboards(index);
+        w.pixels.reset_flag(index, is_updated);
+        c.redraw = merge(c.redraw, merge(c.dirty, c.dirty_next));
+        if (boards.flags[is_burning].any() || boards.awake_types.any()) {
+            w.ticking.set(index);
+        } else {
+            w.ticking.reset(index);
+        }
+    };
+    for (const auto index : stepped) {
+        settle(index);
+    }
+    for (auto index = w.awake.find_last(w.chunks.size()); index != chunk_bitset::npos; index = w.awake.find_last(index)) {
+        if (!w.stepping.test(index)) settle(index);
+    }
+
+    // After settling, which reads the dirty rects the colliders are built from
+    update_physics(w, pool, stepped);
+    settle_debris(w);
+    ++w.tick;
 }
 
 }
\ No newline at end of file
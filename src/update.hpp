@@ -3,6 +3,11 @@
 namespace sand {
 
 class world;
-auto update(world& pixel) -> void;
+class thread_pool;
+
+// Steps the world forward by one tick. With a single threaded pool the chunks are walked
+// in order from the bottom of the world to the top. With more threads, awake chunks are
+// updated in four checkerboard passes so no two chunks in the same pass share a border.
+auto update(world& pixel, thread_pool& pool) -> void;
     
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "update_liquids.hpp"
+#include "config.hpp"
+#include "world.hpp"
+#include "pixel.hpp"
+#include "profiler.hpp"
+#include "scratch.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace sand {
+namespace {
+
+static constexpr auto size = config::chunk_size;
+
+auto is_liquid(pixel_type type) -> bool
+{
+    return hot_properties(type).phase == pixel_phase::liquid;
+}
+
+}
+
+auto level_liquids(world& w, std::size_t index) -> void
+{
+    const auto zone = profile_zone{"level_liquids"};
+    const auto top_left = size * get_chunk_pos(w, index);
+    const auto& page = w.pixels.page(index);
+
+    // Pixels are indexed x + size * y within the chunk, so sorting the indices sorts by row
+    auto& scratch = scratch_arena::for_this_thread(w.scratch_epoch);
+    auto body = std::pmr::vector<std::uint16_t>{&scratch};
+    auto surface = std::pmr::vector<std::uint16_t>{&scratch}; // With air above
+    auto outlets = std::pmr::vector<std::uint16_t>{&scratch}; // Air beside or below
+    auto visited = std::bitset<chunk_page::size>{};
+    auto is_outlet = std::bitset<chunk_page::size>{};
+
+    for (std::size_t start = 0; start != chunk_page::size; ++start) {
+        if (visited[start] || !is_liquid(page.type[start])) continue;
+        const auto type = page.type[start];
+
+        body.assign(1, static_cast<std::uint16_t>(start));
+        surface.clear();
+        outlets.clear();
+        visited[start] = true;
+
+        for (std::size_t i = 0; i != body.size(); ++i) {
+            const auto j = body[i];
+            const auto x = j % size;
+            const auto y = j / size;
+            if (y > 0 && page.type[j - size] == pixel_type::none) {
+                surface.push_back(j);
+            }
+
+            const auto visit = [&](int nx, int ny, bool can_be_outlet) {
+                if (nx < 0 || nx >= size || ny < 0 || ny >= size) return;
+                const auto k = static_cast<std::uint16_t>(nx + size * ny);
+                if (page.type[k] == type) {
+                    if (!visited[k]) {
+                        visited[k] = true;
+                        body.push_back(k);
+                    }
+                } else if (can_be_outlet && page.type[k] == pixel_type::none && !is_outlet[k]) {
+                    is_outlet[k] = true;
+                    outlets.push_back(k);
+                }
+            };
+            visit(x - 1, y, true);
+            visit(x + 1, y, true);
+            visit(x, y + 1, true);
+            visit(x, y - 1, false);
+        }
+
+        // The highest surface pixels go to the lowest outlets, each move taking a pixel down
+        // by at least two rows, so the levelling always ends
+        std::ranges::sort(surface);
+        std::ranges::sort(outlets, std::greater{});
+        const auto moves = std::min(surface.size(), outlets.size());
+        for (std::size_t i = 0; i != moves; ++i) {
+            if (surface[i] / size + 1 >= outlets[i] / size) break;
+            const auto from = top_left + glm::ivec2{surface[i] % size, surface[i] / size};
+            const auto to = top_left + glm::ivec2{outlets[i] % size, outlets[i] / size};
+            w.pixels.swap(from, to);
+            w.pixels[to].flags[is_falling] = true;
+            w.wake_chunk_with_pixel(from);
+            w.wake_chunk_with_pixel(to);
+            visited[outlets[i]] = true; // Moved once this tick is enough
+        }
+
+        for (const auto k : outlets) {
+            is_outlet[k] = false;
+        }
+    }
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+namespace sand {
+
+class world;
+
+// Levels the bodies of liquid in a chunk. Each body is the pixels of one liquid type
+// connected within the chunk, and its highest surface pixels are moved into the lowest
+// empty cells beside it, as long as that takes them down at least two rows, so the
+// surfaces of a body even out however it is shaped, even either side of a wall it flows
+// under. A body that is level moves nothing, so once the pixels settle the chunk sleeps.
+//
+// Only the chunk's own pixels are read or written, so chunks can be levelled in parallel,
+// and liquid flows across chunk edges as it always has.
+auto level_liquids(world& w, std::size_t index) -> void;
+
+}
@@ -2,81 +2,87 @@
 #include "config.hpp"
 #include "world.hpp"
 #include "utility.hpp"
+#include "profiler.hpp"
+#include "scratch.hpp"
+#include "thread_pool.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <bitset>
+#include <cassert>
+#include <chrono>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <utility>
 #include <vector>
 #include <print>
+#include <unordered_map>
 
 #include <glm/glm.hpp>
+#include <glm/gtx/norm.hpp>
 
 namespace sand {
 
-using chunk_static_pixels = std::bitset<sand::config::chunk_size * sand::config::chunk_size>;
+// Every buffer used while building a collider comes from the scratch arena of the thread
+// doing it, so rebuilding colliders does not touch the heap once the arenas have grown
+using point_list = std::pmr::vector<glm::ivec2>;
 
-auto is_static_pixel(
-    glm::ivec2 top_left,
-    const sand::world& w,
-    glm::ivec2 pos) -> bool
+// Whether the chunk local position is one of the pixels, nothing outside the chunk is
+auto is_set(const chunk_bitboard& pixels, glm::ivec2 pos) -> bool
 {
-    if (!(top_left.x <= pos.x && pos.x < top_left.x + sand::config::chunk_size) || !(top_left.y <= pos.y && pos.y < top_left.y + sand::config::chunk_size)) return false;
-    
-    if (!w.pixels.valid(pos)) return false;
-    const auto& pixel = w.pixels[pos];
-    const auto& props = sand::properties(pixel);
-    return pixel.type != sand::pixel_type::none
-        && props.phase == sand::pixel_phase::solid
-        && !pixel.flags.test(sand::pixel_flags::is_falling);
+    if (!(0 <= pos.x && pos.x < sand::config::chunk_size) || !(0 <= pos.y && pos.y < sand::config::chunk_size)) return false;
+    return (pixels.rows[pos.y] >> pos.x) & 1u;
 }
 
 auto is_static_boundary(
-    glm::ivec2 top_left,
-    const sand::world& w,
+    const chunk_bitboard& pixels,
     glm::ivec2 A, glm::ivec2 offset) -> bool
 {
     assert(glm::abs(offset.x) + glm::abs(offset.y) == 1);
-    const auto static_a = is_static_pixel(top_left, w, A);
-    const auto static_b = is_static_pixel(top_left, w, A + offset);
+    const auto static_a = is_set(pixels, A);
+    const auto static_b = is_set(pixels, A + offset);
     return (!static_a && static_b) || (!static_b && static_a);
 }
 
 auto is_along_boundary(
-    glm::ivec2 top_left,
-    const sand::world& w,
+    const chunk_bitboard& pixels,
     glm::ivec2 curr, glm::ivec2 next) -> bool
 {
     const auto offset = next - curr;
     assert(glm::abs(offset.x) + glm::abs(offset.y) == 1);
-    if (offset == up)    return is_static_boundary(top_left, w, next, left);
-    if (offset == down)  return is_static_boundary(top_left, w, curr, left);
-    if (offset == left)  return is_static_boundary(top_left, w, next, up);
-    if (offset == right) return is_static_boundary(top_left, w, curr, up);
+    if (offset == up)    return is_static_boundary(pixels, next, left);
+    if (offset == down)  return is_static_boundary(pixels, curr, left);
+    if (offset == left)  return is_static_boundary(pixels, next, up);
+    if (offset == right) return is_static_boundary(pixels, curr, up);
     std::unreachable();
 }
 
 auto is_boundary_cross(
-    glm::ivec2 top_left,
-    const sand::world& w,
+    const chunk_bitboard& pixels,
     glm::ivec2 curr) -> bool
 {
-    const auto tl = is_static_pixel(top_left, w, curr + left + up);
-    const auto tr = is_static_pixel(top_left, w, curr + up);
-    const auto bl = is_static_pixel(top_left, w, curr + left);
-    const auto br = is_static_pixel(top_left, w, curr);
+    const auto tl = is_set(pixels, curr + left + up);
+    const auto tr = is_set(pixels, curr + up);
+    const auto bl = is_set(pixels, curr + left);
+    const auto br = is_set(pixels, curr);
     return (tl == br) && (bl == tr) && (tl != tr);
 }
 
 auto is_valid_step(
-    glm::ivec2 top_left,
-    const sand::world& w,
+    const chunk_bitboard& pixels,
     glm::ivec2 prev,
     glm::ivec2 curr,
     glm::ivec2 next) -> bool
 {
-    if (!is_along_boundary(top_left, w, curr, next)) return false;
+    if (!is_along_boundary(pixels, curr, next)) return false;
     if (prev.x == 0 && prev.y == 0) return true;
     if (prev == next) return false;
 
-    if (!is_boundary_cross(top_left, w, curr)) return true;
+    if (!is_boundary_cross(pixels, curr)) return true;
 
     // in a straight line going over the cross
     if ((prev.x == curr.x && curr.x == next.x) || (prev.y == curr.y && curr.y == next.y)) {
@@ -88,24 +94,27 @@ auto is_valid_step(
         std::min({prev.x, curr.x, next.x}),
         std::min({prev.y, curr.y, next.y})
     };
-    return is_static_pixel(top_left, w, pixel);
+    return is_set(pixels, pixel);
 }
 
-auto get_boundary(
-    glm::ivec2 top_left,
-    const sand::world& w,
-    glm::ivec2 start) -> std::vector<glm::ivec2>
+// Follows the edge between the pixels and the gaps around them from a corner on it, back
+// to that corner. Points are the top left corners of pixels, with the start repeated at
+// the end. Since a step through a cross must go round a pixel, the pixels only join up
+// through their sides and the gaps also join up through their corners.
+auto trace_loop(
+    const chunk_bitboard& pixels,
+    glm::ivec2 start,
+    std::pmr::memory_resource* scratch) -> point_list
 {
-    auto ret = std::vector<glm::ivec2>{};
+    auto ret = point_list{scratch};
     auto current = start;
-    while (is_static_pixel(top_left, w, current + up)) { current += up; }
     ret.push_back(current);
     
     // Find second point
     bool found_second = false;
     for (const auto offset : offsets) {
         const auto neigh = current + offset;
-        if (is_valid_step(top_left, w, {0, 0}, current, neigh)) {
+        if (is_valid_step(pixels, {0, 0}, current, neigh)) {
             current = neigh;
             ret.push_back(current);
             found_second = true;
@@ -113,7 +122,8 @@ auto get_boundary(
         }
     }
     if (!found_second) {
-        return {};
+        ret.clear();
+        return ret;
     }
 
     // continue until we get back to the start
@@ -121,7 +131,7 @@ auto get_boundary(
         bool found = false;
         for (const auto offset : offsets) {
             const auto neigh = current + offset;
-            if (is_valid_step(top_left, w, ret.rbegin()[1], current, neigh)) {
+            if (is_valid_step(pixels, ret.rbegin()[1], current, neigh)) {
                 current = neigh;
                 found = true;
                 ret.push_back(current);
@@ -150,7 +160,7 @@ auto perpendicular_distance(glm::ivec2 p, glm::ivec2 a, glm::ivec2 b) -> float
     return glm::abs(cross(ab, ap)) / glm::length(ab);
 }
 
-auto ramer_douglas_puecker(std::span<const glm::ivec2> points, float epsilon, std::vector<glm::ivec2>& out) -> void
+auto ramer_douglas_puecker(std::span<const glm::ivec2> points, float epsilon, point_list& out) -> void
 {
     if (points.size() < 3) {
         out.insert(out.end(), points.begin(), points.end());
@@ -177,21 +187,6 @@ auto ramer_douglas_puecker(std::span<const glm::ivec2> points, float epsilon, st
     }
 }
 
-auto calc_boundary(
-    glm::ivec2 top_left,
-    const sand::world& w,
-    glm::ivec2 start,
-    float epsilon) -> std::vector<glm::ivec2>
-{
-    const auto points = get_boundary(top_left, w, start);
-    if (epsilon == 0.0f) {
-        return points;
-    }
-    auto simplified = std::vector<glm::ivec2>{};
-    ramer_douglas_puecker(points, epsilon, simplified);
-    return simplified;
-}
-
 struct triangle
 {
     glm::ivec2 a;
@@ -207,29 +202,36 @@ auto new_body(b2World& world) -> b2Body*
     return world.CreateBody(&bodyDef);
 }
 
-auto add_triangles_to_body(b2Body& body, const std::vector<triangle>& triangles) -> void
+auto add_shapes_to_body(
+    b2Body& body,
+    std::span<const collider_shape> shapes,
+    collider_mode mode,
+    std::pmr::memory_resource* scratch) -> std::vector<b2Fixture*>
 {
     b2PolygonShape polygonShape;
     b2FixtureDef fixtureDef;
     fixtureDef.shape = &polygonShape;
 
-    for (const triangle& t : triangles) {
-        const auto vertices = {
-            sand::pixel_to_physics(t.a),
-            sand::pixel_to_physics(t.b),
-            sand::pixel_to_physics(t.c)
-        };
+    auto fixtures = std::vector<b2Fixture*>{};
+    fixtures.reserve(shapes.size());
 
-        polygonShape.Set(std::data(vertices), std::size(vertices)); 
-        body.CreateFixture(&fixtureDef);
-    }
-}
+    auto vertices = std::pmr::vector<b2Vec2>{scratch};
+    for (const auto& shape : shapes) {
+        vertices.clear();
+        for (const auto point : shape) {
+            vertices.push_back(sand::pixel_to_physics(point));
+        }
 
-auto triangles_to_rigid_bodies(b2World& world, const std::vector<triangle>& triangles) -> b2Body*
-{
-    b2Body* body = new_body(world);
-    add_triangles_to_body(*body, triangles);
-    return body;
+        if (mode == collider_mode::chain) {
+            b2ChainShape chainShape;
+            chainShape.CreateLoop(vertices.data(), static_cast<int>(vertices.size()));
+            fixtures.push_back(body.CreateFixture(&chainShape, 0.0f));
+        } else {
+            polygonShape.Set(vertices.data(), static_cast<int>(vertices.size()));
+            fixtures.push_back(body.CreateFixture(&fixtureDef));
+        }
+    }
+    return fixtures;
 }
 
 inline auto are_collinear(glm::ivec2 a, glm::ivec2 b, glm::ivec2 c) -> bool
@@ -253,27 +255,10 @@ auto point_in_triangle(glm::ivec2 p, const triangle& t) -> bool
             (area_abc <= 0 && area_pab <= 0 && area_pbc <= 0 && area_pca <= 0);
 }
 
-// Check if a triangle is valid (no points inside it and not degenerate)
-auto is_valid_triangle(const triangle& t, std::span<const glm::ivec2> points) -> bool
-{
-    if (are_collinear(t.a, t.b, t.c)) {
-        return false;  // Collinear points cannot form a valid triangle
-    }
-
-    for (const auto& point : points) {
-        if (point != t.a && point != t.b && point != t.c) {
-            if (point_in_triangle(point, t)) {
-                return false;  // Point is inside the triangle, so it's not a valid triangle
-            }
-        }
-    }
-    return true;
-}
-
-auto remove_collinear_points(const std::vector<glm::ivec2>& points) -> std::vector<glm::ivec2>
+auto remove_collinear_points(const point_list& points) -> point_list
 {
     const auto n = points.size();
-    auto filtered_points = std::vector<glm::ivec2>{};
+    auto filtered_points = point_list{points.get_allocator()};
 
     for (std::size_t curr = 0; curr != n; ++curr) {
         const auto prev = (curr == 0) ? n - 1 : curr - 1;
@@ -286,112 +271,685 @@ auto remove_collinear_points(const std::vector<glm::ivec2>& points) -> std::vect
     return filtered_points;
 }
 
-auto triangulate(std::vector<glm::ivec2> vertices) -> std::vector<triangle>
+// Whether the segments ab and cd cross or touch, other than at a shared end
+auto segments_intersect(glm::ivec2 a, glm::ivec2 b, glm::ivec2 c, glm::ivec2 d) -> bool
 {
-    auto triangles = std::vector<triangle>{};
-    auto points = remove_collinear_points(vertices);  // Work on a copy of the vertices
+    if (a == c || a == d || b == c || b == d) return false;
+    const auto on_segment = [](glm::ivec2 p, glm::ivec2 q, glm::ivec2 r) {
+        return std::min(p.x, r.x) <= q.x && q.x <= std::max(p.x, r.x)
+            && std::min(p.y, r.y) <= q.y && q.y <= std::max(p.y, r.y);
+    };
+    const auto sign = [](float x) { return (x > 0) - (x < 0); };
+    const auto o1 = sign(cross(b - a, c - a));
+    const auto o2 = sign(cross(b - a, d - a));
+    const auto o3 = sign(cross(d - c, a - c));
+    const auto o4 = sign(cross(d - c, b - c));
+    if (o1 != o2 && o3 != o4) return true;
+    return (o1 == 0 && on_segment(a, c, b)) || (o2 == 0 && on_segment(a, d, b))
+        || (o3 == 0 && on_segment(c, a, d)) || (o4 == 0 && on_segment(c, b, d));
+}
 
-    while (points.size() > 3) {
-        bool earFound = false;
+// Whether a diagonal from the vertex at i of the anticlockwise loop towards p starts off
+// inside it
+auto is_locally_inside(std::span<const glm::ivec2> loop, std::size_t i, glm::ivec2 p) -> bool
+{
+    const auto prev = loop[(i + loop.size() - 1) % loop.size()];
+    const auto curr = loop[i];
+    const auto next = loop[(i + 1) % loop.size()];
+    if (is_convex(prev, curr, next)) {
+        return cross(p - curr, next - curr) <= 0 && cross(prev - curr, p - curr) <= 0;
+    }
+    return cross(p - curr, prev - curr) > 0 || cross(next - curr, p - curr) > 0;
+}
 
-        for (size_t curr = 0; curr < points.size(); ++curr) {
-            const auto prev = (curr == 0) ? points.size() - 1 : curr - 1;
-            const auto next = (curr == points.size() - 1) ? 0 : curr + 1;
-            const auto t = triangle{points[prev], points[curr], points[next]};
+// Whether the segment crosses an edge of any of the loops
+auto crosses_any(glm::ivec2 a, glm::ivec2 b, std::span<const point_list> loops) -> bool
+{
+    for (const auto& loop : loops) {
+        for (std::size_t i = 0; i != loop.size(); ++i) {
+            if (segments_intersect(a, b, loop[i], loop[(i + 1) % loop.size()])) return true;
+        }
+    }
+    return false;
+}
 
-            if (!is_convex(t.a, t.b, t.c)) {
-                continue;
-            }
+// Joins each hole to the outside with a pair of edges to a vertex it can see, leaving a
+// single loop that touches itself along the bridges, as earcut does. Holes are joined from
+// left to right, each at its leftmost point.
+auto bridge_holes(point_list outer, std::pmr::vector<point_list> holes) -> point_list
+{
+    const auto leftmost = [](const point_list& loop) {
+        return static_cast<std::size_t>(std::ranges::min_element(loop, [](glm::ivec2 a, glm::ivec2 b) {
+            return std::tie(a.x, a.y) < std::tie(b.x, b.y);
+        }) - loop.begin());
+    };
+    std::erase_if(holes, [](const auto& hole) { return hole.size() < 3; });
+    std::ranges::sort(holes, {}, [&](const auto& hole) { return hole[leftmost(hole)].x; });
+
+    auto candidates = std::pmr::vector<std::size_t>{outer.get_allocator()};
+    for (std::size_t h = 0; h != holes.size(); ++h) {
+        const auto& hole = holes[h];
+        const auto m = leftmost(hole);
+        const auto point = hole[m];
+
+        // Try the vertices of the outside nearest first
+        candidates.resize(outer.size());
+        std::iota(candidates.begin(), candidates.end(), std::size_t{0});
+        std::ranges::sort(candidates, {}, [&](std::size_t i) { return glm::length2(glm::vec2{outer[i] - point}); });
+
+        const auto remaining = std::span{holes}.subspan(h);
+        const auto bridge = std::ranges::find_if(candidates, [&](std::size_t i) {
+            return is_locally_inside(outer, i, point)
+                && is_locally_inside(hole, m, outer[i])
+                && !crosses_any(outer[i], point, {&outer, 1})
+                && !crosses_any(outer[i], point, remaining);
+        });
+        if (bridge == candidates.end()) continue; // Leaves the hole filled in
+
+        auto joined = point_list{outer.get_allocator()};
+        joined.reserve(outer.size() + hole.size() + 2);
+        joined.insert(joined.end(), outer.begin(), outer.begin() + *bridge + 1);
+        for (std::size_t i = 0; i <= hole.size(); ++i) {
+            joined.push_back(hole[(m + i) % hole.size()]);
+        }
+        joined.insert(joined.end(), outer.begin() + *bridge, outer.end());
+        outer = std::move(joined);
+    }
+    return outer;
+}
+
+// Ear clipping over a linked list of the vertices, so clipping an ear does not move the
+// rest and the scan carries on from where it was. Only reflex vertices can be inside an
+// ear, and they are looked up in a grid over the polygon rather than testing every point.
+// The outside must be wound anticlockwise and the holes clockwise.
+auto triangulate(point_list outer, std::pmr::vector<point_list> holes) -> std::pmr::vector<triangle>
+{
+    const auto zone = profile_zone{"triangulate"};
+    const auto scratch = outer.get_allocator();
+    auto triangles = std::pmr::vector<triangle>{scratch};
+    const auto points = bridge_holes(std::move(outer), std::move(holes));
+    if (points.size() < 3) return triangles;
+
+    struct node
+    {
+        glm::ivec2  pos;
+        std::size_t prev;
+        std::size_t next;
+        bool        removed = false;
+    };
+    auto nodes = std::pmr::vector<node>{scratch};
+    nodes.reserve(points.size());
+    for (std::size_t i = 0; i != points.size(); ++i) {
+        nodes.push_back({points[i], (i + points.size() - 1) % points.size(), (i + 1) % points.size()});
+    }
+
+    static constexpr auto cell_size = 8;
+    auto min = points.front();
+    auto max = points.front();
+    for (const auto point : points) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    const auto cells = (max - min) / cell_size + 1;
+    const auto cell_of = [&](glm::ivec2 pos) {
+        const auto cell = (pos - min) / cell_size;
+        return static_cast<std::size_t>(cell.x + cells.x * cell.y);
+    };
+
+    // The nodes sorted by cell, with the nodes of cell i in [cell_starts[i], cell_starts[i + 1])
+    auto cell_starts = std::pmr::vector<std::size_t>(cells.x * cells.y + 1, 0, scratch);
+    auto cell_nodes = std::pmr::vector<std::size_t>(nodes.size(), scratch);
+    for (const auto& n : nodes) {
+        ++cell_starts[cell_of(n.pos) + 1];
+    }
+    std::partial_sum(cell_starts.begin(), cell_starts.end(), cell_starts.begin());
+    {
+        auto next = std::pmr::vector<std::size_t>(cell_starts.begin(), cell_starts.end() - 1, scratch);
+        for (std::size_t i = 0; i != nodes.size(); ++i) {
+            cell_nodes[next[cell_of(nodes[i].pos)]++] = i;
+        }
+    }
 
-            if (is_valid_triangle(t, points)) {
-                triangles.push_back(t);
-                points.erase(points.begin() + curr);
-                earFound = true;
-                break;  // start over with the reduced polygon
+    const auto is_ear = [&](std::size_t i) {
+        const auto& n = nodes[i];
+        const auto t = triangle{nodes[n.prev].pos, n.pos, nodes[n.next].pos};
+        const auto lo = (glm::min(t.a, glm::min(t.b, t.c)) - min) / cell_size;
+        const auto hi = (glm::max(t.a, glm::max(t.b, t.c)) - min) / cell_size;
+        for (int y = lo.y; y <= hi.y; ++y) {
+            for (int x = lo.x; x <= hi.x; ++x) {
+                const auto cell = static_cast<std::size_t>(x + cells.x * y);
+                for (auto k = cell_starts[cell]; k != cell_starts[cell + 1]; ++k) {
+                    const auto& other = nodes[cell_nodes[k]];
+                    if (other.removed || other.pos == t.a || other.pos == t.b || other.pos == t.c) continue;
+                    if (is_convex(nodes[other.prev].pos, other.pos, nodes[other.next].pos)) continue;
+                    if (point_in_triangle(other.pos, t)) return false;
+                }
             }
         }
+        return true;
+    };
 
-        if (!earFound) {
-            break;
+    const auto remove = [&](std::size_t i) {
+        auto& n = nodes[i];
+        n.removed = true;
+        nodes[n.prev].next = n.next;
+        nodes[n.next].prev = n.prev;
+    };
+
+    triangles.reserve(points.size() - 2);
+
+    // Stop once a whole lap finds nothing to clip, which only happens if the loop crosses itself
+    auto remaining = nodes.size();
+    auto curr = std::size_t{0};
+    auto stop = curr;
+    while (remaining > 3) {
+        const auto& n = nodes[curr];
+        const auto prev = nodes[n.prev].pos;
+        const auto next = nodes[n.next].pos;
+        const auto following = n.next;
+
+        if (are_collinear(prev, n.pos, next)) {
+            // Straight runs, spikes and the repeated points at either end of a bridge
+            remove(curr);
+            --remaining;
+            curr = stop = following;
+        } else if (is_convex(prev, n.pos, next) && is_ear(curr)) {
+            triangles.push_back({prev, n.pos, next});
+            remove(curr);
+            --remaining;
+            curr = stop = following;
+        } else {
+            curr = following;
+            if (curr == stop) break;
         }
     }
 
-    if (points.size() == 3) {
-        triangles.push_back({points[0], points[1], points[2]});
+    if (remaining == 3) {
+        const auto& n = nodes[curr];
+        const auto t = triangle{nodes[n.prev].pos, n.pos, nodes[n.next].pos};
+        if (is_convex(t.a, t.b, t.c)) {
+            triangles.push_back(t);
+        }
     }
 
     return triangles;
 }
 
-auto flood_remove(chunk_static_pixels& pixels, glm::ivec2 pos) -> void
+// Whether the polygon never turns clockwise, allowing for collinear points
+auto is_convex_polygon(const collider_shape& shape) -> bool
 {
-    const auto is_valid = [](const glm::ivec2 p) {
-        return 0 <= p.x && p.x < sand::config::chunk_size && 0 <= p.y && p.y < sand::config::chunk_size;
+    const auto n = shape.size();
+    for (std::size_t i = 0; i != n; ++i) {
+        if (cross(shape[(i + 1) % n] - shape[i], shape[(i + 2) % n] - shape[i]) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Joins two anticlockwise polygons along an edge, running a -> b in p and b -> a in q
+auto join_polygons(const collider_shape& p, std::size_t p_a, const collider_shape& q) -> collider_shape
+{
+    const auto a = p[p_a];
+    const auto b = p[(p_a + 1) % p.size()];
+    const auto q_b = static_cast<std::size_t>(std::ranges::find(q, b) - q.begin());
+    assert(q_b != q.size() && q[(q_b + 1) % q.size()] == a);
+
+    auto joined = collider_shape{p.get_allocator()};
+    joined.reserve(p.size() + q.size() - 2);
+    for (std::size_t i = 1; i <= p.size(); ++i) {
+        joined.push_back(p[(p_a + i) % p.size()]); // From b round to a
+    }
+    for (std::size_t i = 2; i != q.size(); ++i) {
+        joined.push_back(q[(q_b + i) % q.size()]); // Then the rest of q
+    }
+    return remove_collinear_points(joined);
+}
+
+// Merges the triangles into larger convex polygons by removing the diagonals between
+// them while the result stays convex and within what Box2D allows (Hertel-Mehlhorn).
+// This gives at most four times the fewest possible pieces, in near linear time.
+auto merge_convex(const std::pmr::vector<triangle>& triangles) -> std::pmr::vector<collider_shape>
+{
+    const auto scratch = triangles.get_allocator();
+    auto polygons = std::pmr::vector<collider_shape>{scratch};
+    polygons.reserve(triangles.size());
+    for (const auto& t : triangles) {
+        polygons.emplace_back().assign({t.a, t.b, t.c});
+    }
+
+    // The polygon to the left of each directed edge. An island never spans more than a
+    // chunk, so the low bits of each coordinate are enough to tell its points apart.
+    const auto key = [](glm::ivec2 a, glm::ivec2 b) {
+        const auto pack = [](glm::ivec2 p) {
+            return std::uint64_t{static_cast<std::uint16_t>(p.x)} | std::uint64_t{static_cast<std::uint16_t>(p.y)} << 16;
+        };
+        return pack(a) << 32 | pack(b);
     };
+    auto owners = std::pmr::unordered_map<std::uint64_t, std::size_t>{scratch};
+    const auto claim_edges = [&](std::size_t i) {
+        const auto& p = polygons[i];
+        for (std::size_t k = 0; k != p.size(); ++k) {
+            owners[key(p[k], p[(k + 1) % p.size()])] = i;
+        }
+    };
+    const auto release_edges = [&](std::size_t i) {
+        const auto& p = polygons[i];
+        for (std::size_t k = 0; k != p.size(); ++k) {
+            owners.erase(key(p[k], p[(k + 1) % p.size()]));
+        }
+    };
+    for (std::size_t i = 0; i != polygons.size(); ++i) {
+        claim_edges(i);
+    }
+
+    // Merged polygons are emptied, and each merge restarts the scan of the polygon it grew
+    for (std::size_t i = 0; i != polygons.size(); ++i) {
+        for (std::size_t k = 0; k < polygons[i].size();) {
+            const auto& p = polygons[i];
+            const auto a = p[k];
+            const auto b = p[(k + 1) % p.size()];
+            const auto it = owners.find(key(b, a));
+            if (it == owners.end() || it->second == i) {
+                ++k;
+                continue;
+            }
+
+            const auto j = it->second;
+            auto joined = join_polygons(p, k, polygons[j]);
+            if (joined.size() > b2_maxPolygonVertices || !is_convex_polygon(joined)) {
+                ++k;
+                continue;
+            }
 
-    const auto to_index = [](const glm::ivec2 p) {
-        return p.y * sand::config::chunk_size + p.x;
+            // Collinear points are dropped from the join, so it may not keep all their edges
+            release_edges(i);
+            release_edges(j);
+            polygons[i] = std::move(joined);
+            polygons[j].clear();
+            claim_edges(i);
+            k = 0;
+        }
+    }
+
+    std::erase_if(polygons, [](const collider_shape& p) { return p.empty(); });
+    return polygons;
+}
+
+// Removes the pixels joined to pos through any of the given offsets
+auto flood_remove(
+    chunk_bitboard& pixels,
+    glm::ivec2 pos,
+    std::span<const glm::ivec2> neighbours,
+    std::pmr::memory_resource* scratch) -> void
+{
+    const auto is_valid = [](const glm::ivec2 p) {
+        return 0 <= p.x && p.x < sand::config::chunk_size && 0 <= p.y && p.y < sand::config::chunk_size;
     };
 
-    std::vector<glm::ivec2> to_visit;
+    auto to_visit = point_list{scratch};
     to_visit.push_back(pos);
     while (!to_visit.empty()) {
         const auto curr = to_visit.back();
         to_visit.pop_back();
-        pixels.reset(to_index(curr));
-        for (const auto offset : offsets) {
+        pixels.set(curr, false);
+        for (const auto offset : neighbours) {
             const auto neigh = curr + offset;
-            if (is_valid(neigh) && pixels.test(to_index(neigh))) {
+            if (is_valid(neigh) && pixels.test(neigh)) {
                 to_visit.push_back(neigh);
             }
         }
     }
 }
 
-auto get_starting_pixel(const chunk_static_pixels& pixels) -> glm::ivec2
+// The leftmost column with a pixel in it, and the topmost pixel in that column
+auto get_starting_pixel(const chunk_bitboard& pixels) -> glm::ivec2
 {
     assert(pixels.any());
-    for (int x = 0; x != sand::config::chunk_size; ++x) {
-        for (int y = 0; y != sand::config::chunk_size; ++y) {
-            const auto index = y * sand::config::chunk_size + x;
-            if (pixels.test(index)) {
-                return {x, y};
-            }
+    auto columns = std::uint64_t{0};
+    for (const auto row : pixels.rows) {
+        columns |= row;
+    }
+    const auto x = std::countr_zero(columns);
+    for (int y = 0; y != sand::config::chunk_size; ++y) {
+        if ((pixels.rows[y] >> x) & 1u) {
+            return {x, y};
         }
     }
     std::unreachable();
 }
 
-auto create_chunk_triangles(world& w, chunk& c, glm::ivec2 top_left) -> void
+auto signed_area(std::span<const glm::ivec2> loop) -> float
 {
-    if (c.triangles) {
-        w.physics.DestroyBody(c.triangles);
+    auto area = 0.0f;
+    for (std::size_t i = 0; i != loop.size(); ++i) {
+        area += cross(loop[i], loop[(i + 1) % loop.size()]);
     }
-    
-    c.triangles = new_body(w.physics);
-    
-    auto chunk_pixels = chunk_static_pixels{};
-    
-    // Fill up the bitset
-    for (int x = 0; x != sand::config::chunk_size; ++x) {
-        for (int y = 0; y != sand::config::chunk_size; ++y) {
-            const auto index = y * sand::config::chunk_size + x;
-            if (is_static_pixel(top_left, w, top_left + glm::ivec2{x, y})) {
-                chunk_pixels.set(index);
+    return area / 2;
+}
+
+// Simplifies a traced loop, without repeating the start, and winds it anticlockwise, or
+// clockwise for holes, in world pixel coordinates
+auto simplify_loop(const point_list& points, glm::ivec2 top_left, bool is_hole) -> point_list
+{
+    // The simplification never includes the first point, which the loop ends with anyway
+    auto simplified = point_list{points.get_allocator()};
+    ramer_douglas_puecker(points, 1.5f, simplified);
+    auto loop = remove_collinear_points(simplified);
+    if ((signed_area(loop) < 0) != is_hole) {
+        std::ranges::reverse(loop);
+    }
+    for (auto& point : loop) {
+        point += top_left;
+    }
+    return loop;
+}
+
+// The boundary of an island, with the outside wound anticlockwise and each hole clockwise
+struct island_outline
+{
+    point_list                   outer;
+    std::pmr::vector<point_list> holes;
+};
+
+// The gaps in an island join up through their corners as well as their sides
+static constexpr auto gap_offsets = std::array{
+    glm::ivec2{0, -1}, glm::ivec2{1, 0}, glm::ivec2{0, 1}, glm::ivec2{-1, 0},
+    glm::ivec2{-1, -1}, glm::ivec2{1, -1}, glm::ivec2{-1, 1}, glm::ivec2{1, 1}
+};
+
+auto get_island_outline(const chunk_bitboard& island, glm::ivec2 top_left, std::pmr::memory_resource* scratch) -> island_outline
+{
+    auto outline = island_outline{
+        .outer = simplify_loop(trace_loop(island, get_starting_pixel(island), scratch), top_left, false),
+        .holes = std::pmr::vector<point_list>{scratch}
+    };
+
+    // Holes are the gaps that cannot reach the edge of the chunk
+    auto gaps = chunk_bitboard{};
+    for (int y = 0; y != sand::config::chunk_size; ++y) {
+        gaps.rows[y] = ~island.rows[y];
+    }
+    for (int i = 0; i != sand::config::chunk_size; ++i) {
+        for (const auto edge : {glm::ivec2{i, 0}, glm::ivec2{i, sand::config::chunk_size - 1},
+                                glm::ivec2{0, i}, glm::ivec2{sand::config::chunk_size - 1, i}}) {
+            if (gaps.test(edge)) flood_remove(gaps, edge, gap_offsets, scratch);
+        }
+    }
+
+    // The top left corner of the first pixel in a hole has the island above it and to its
+    // left, so it is on the boundary of the hole
+    while (gaps.any()) {
+        const auto pos = get_starting_pixel(gaps);
+        flood_remove(gaps, pos, gap_offsets, scratch);
+        outline.holes.push_back(simplify_loop(trace_loop(island, pos, scratch), top_left, true));
+    }
+    return outline;
+}
+
+// The shapes to build the island from, or none if its boundary is too small to use
+auto island_shapes(island_outline outline, collider_mode mode) -> std::pmr::vector<collider_shape>
+{
+    auto shapes = std::pmr::vector<collider_shape>{outline.outer.get_allocator()};
+    if (outline.outer.size() < 3) return shapes;
+    switch (mode) {
+        case collider_mode::chain: {
+            // Chains only collide on the side their normals face, and the windings of the
+            // outline face them all out of the island
+            shapes.push_back(std::move(outline.outer));
+            for (auto& hole : outline.holes) {
+                if (hole.size() >= 3) shapes.push_back(std::move(hole));
+            }
+            return shapes;
+        }
+        case collider_mode::convex: {
+            return merge_convex(triangulate(std::move(outline.outer), std::move(outline.holes)));
+        }
+        case collider_mode::triangles: {
+            for (const auto& t : triangulate(std::move(outline.outer), std::move(outline.holes))) {
+                shapes.emplace_back().assign({t.a, t.b, t.c});
+            }
+            return shapes;
+        }
+    }
+    std::unreachable();
+}
+
+// Refreshes the cached bitboard within the rect and works out the islands that changed
+auto compute_collider(const world& w, chunk& c, glm::ivec2 top_left, chunk_rect rect) -> chunk_collider_update
+{
+    auto& scratch = scratch_arena::for_this_thread(w.scratch_epoch);
+    auto update = chunk_collider_update{w.colliders, &scratch};
+
+    // Refresh the cached bitboard a row at a time. Static pixels are the occupied ones
+    // that are solid and not falling.
+    auto changed = false;
+    if (!rect.empty()) {
+        const auto& boards = w.pixels.bitboards(top_left);
+        const auto& types = w.pixels.page(get_chunk_index(w, top_left / config::chunk_size)).type;
+        const auto columns = rect.columns();
+        for (int y = rect.min.y; y <= rect.max.y; ++y) {
+            const auto row_start = y * config::chunk_size;
+            auto solid = std::uint64_t{0};
+            for (int x = rect.min.x; x <= rect.max.x; ++x) {
+                const auto phase = hot_properties(types[row_start + x]).phase;
+                solid |= std::uint64_t{phase == pixel_phase::solid} << x;
+            }
+            const auto row = boards.occupied.rows[y] & ~boards.flags[is_falling].rows[y] & solid;
+            auto& cached = c.static_pixels.rows[y];
+            if ((cached & columns) != row) {
+                cached = (cached & ~columns) | row;
+                changed = true;
             }
         }
     }
+    if (!changed) return update;
     
-    // While bitset still has elements, take one, apply algorithm to create
-    // triangles, then flood remove the pixels
+    // Split the bitset into islands by flood removing one at a time. Islands that match
+    // one from the last build keep their fixtures, the rest get new shapes.
+    auto old_islands = std::exchange(c.islands, {});
+    auto chunk_pixels = c.static_pixels;
     while (chunk_pixels.any()) {
-        const auto pos = get_starting_pixel(chunk_pixels) + top_left;
-        const auto boundary = calc_boundary(top_left, w, pos, 1.5f);
-        const auto triangles = triangulate(boundary);
-        add_triangles_to_body(*c.triangles, triangles);
-        flood_remove(chunk_pixels, pos - top_left);
+        const auto pos = get_starting_pixel(chunk_pixels);
+        auto island = chunk_island{.pixels = chunk_pixels};
+        flood_remove(chunk_pixels, pos, offsets, &scratch);
+        island.pixels ^= chunk_pixels;
+
+        const auto it = std::ranges::find(old_islands, island.pixels, &chunk_island::pixels);
+        if (it != old_islands.end()) {
+            island.fixtures = std::move(it->fixtures);
+            old_islands.erase(it);
+        } else {
+            update.new_shapes.emplace_back(c.islands.size(), island_shapes(get_island_outline(island.pixels, top_left, &scratch), update.mode));
+        }
+        c.islands.push_back(std::move(island));
+    }
+
+    for (const auto& island : old_islands) {
+        update.to_destroy.insert(update.to_destroy.end(), island.fixtures.begin(), island.fixtures.end());
     }
+    return update;
+}
+
+auto apply_chunk_collider(world& w, chunk& c, chunk_collider_update&& update) -> void
+{
+    if (update.new_shapes.empty() && update.to_destroy.empty()) return;
+    if (!c.triangles) {
+        c.triangles = new_body(w.physics);
+        w.physics_enabled.set(static_cast<std::size_t>(&c - w.chunks.data()));
+    }
+
+    for (auto fixture : update.to_destroy) {
+        c.triangles->DestroyFixture(fixture);
+    }
+    for (const auto& [island, shapes] : update.new_shapes) {
+        c.islands[island].fixtures = add_shapes_to_body(*c.triangles, shapes, update.mode, &scratch_arena::for_this_thread(w.scratch_epoch));
+    }
+    ++c.collider_version;
+}
+
+auto rebuild_colliders(world& w) -> void
+{
+    const auto zone = profile_zone{"rebuild_colliders"};
+    const auto scope = scratch_scope{w.scratch_epoch};
+    for (std::size_t index = 0; index != w.chunks.size(); ++index) {
+        auto& c = w.chunks[index];
+        if (c.triangles) {
+            w.physics.DestroyBody(c.triangles);
+            c.triangles = nullptr;
+            w.physics_enabled.reset(index);
+            ++c.collider_version;
+        }
+        c.islands.clear();
+        c.static_pixels.clear();
+        c.collider_pending = chunk_rect{};
+
+        const auto top_left = sand::config::chunk_size * get_chunk_pos(w, index);
+        apply_chunk_collider(w, c, compute_collider(w, c, top_left, chunk_rect::full()));
+    }
+}
+
+// The centres of the bodies that chunk colliders are kept around, in pixel space
+auto dynamic_body_centres(const world& w, std::pmr::memory_resource* scratch) -> std::pmr::vector<glm::vec2>
+{
+    auto centres = std::pmr::vector<glm::vec2>{scratch};
+    centres.push_back(w.player.centre());
+    for (const auto& d : w.debris) {
+        centres.push_back(physics_to_pixel(d.body->GetWorldCenter()));
+    }
+    return centres;
+}
+
+auto distance_to_chunk(glm::vec2 point, glm::ivec2 chunk_pos) -> float
+{
+    const auto min = glm::vec2{config::chunk_size * chunk_pos};
+    const auto max = min + glm::vec2{config::chunk_size};
+    const auto d = glm::max(glm::max(min - point, point - max), glm::vec2{0.0f});
+    return glm::length(d);
+}
+
+auto is_near_any(std::span<const glm::vec2> centres, glm::ivec2 chunk_pos, float distance) -> bool
+{
+    return std::ranges::any_of(centres, [&](glm::vec2 centre) {
+        return distance_to_chunk(centre, chunk_pos) <= distance;
+    });
+}
+
+// The chunks within the distance of any of the centres, highest index first
+auto chunks_near(
+    const world& w,
+    std::span<const glm::vec2> centres,
+    float distance,
+    std::pmr::memory_resource* scratch) -> std::pmr::vector<std::size_t>
+{
+    const auto num_chunks = glm::ivec2{w.pixels.width(), w.pixels.height()} / config::chunk_size;
+    auto near = std::pmr::vector<std::size_t>{scratch};
+    for (const auto centre : centres) {
+        const auto lo = glm::max(glm::ivec2{glm::floor((centre - distance) / float{config::chunk_size})}, glm::ivec2{0});
+        const auto hi = glm::min(glm::ivec2{glm::floor((centre + distance) / float{config::chunk_size})}, num_chunks - 1);
+        for (int y = lo.y; y <= hi.y; ++y) {
+            for (int x = lo.x; x <= hi.x; ++x) {
+                if (distance_to_chunk(centre, {x, y}) <= distance) {
+                    near.push_back(get_chunk_index(w, {x, y}));
+                }
+            }
+        }
+    }
+    std::ranges::sort(near, std::greater{});
+    near.erase(std::ranges::unique(near).begin(), near.end());
+    return near;
+}
+
+auto update_physics(world& w, thread_pool& pool, std::span<const std::size_t> stepped) -> void
+{
+    const auto zone = profile_zone{"update_physics"};
+    auto& scratch = scratch_arena::for_this_thread(w.scratch_epoch);
+
+    // Pixels outside of the dirty regions cannot have changed, so those are all that need
+    // looking at when the collider is next built
+    for (const auto index : stepped) {
+        auto& c = w.chunks[index];
+        c.collider_pending = merge(c.collider_pending, merge(c.dirty, c.dirty_next));
+    }
+
+    const auto centres = dynamic_body_centres(w, &scratch);
+    const auto near = chunks_near(w, centres, config::physics_distance, &scratch);
+
+    // Each chunk only reads the pixels and writes its own islands, so the geometry is worked
+    // out in parallel, but Box2D is not thread safe so the fixtures are then made serially
+    // in a fixed order
+    auto to_build = std::pmr::vector<std::size_t>{&scratch};
+    for (const auto index : near) {
+        if (!w.chunks[index].collider_pending.empty()) to_build.push_back(index);
+    }
+    auto colliders = std::pmr::vector<std::optional<chunk_collider_update>>(to_build.size(), &scratch);
+    using clock = std::chrono::steady_clock;
+    const auto elapsed_ms = [](clock::time_point start) {
+        return std::chrono::duration<float, std::milli>{clock::now() - start}.count();
+    };
+    pool.parallel_for(to_build.size(), [&](std::size_t i) {
+        const auto compute_zone = profile_zone{"compute_chunk_collider"};
+        const auto start = clock::now();
+        auto& c = w.chunks[to_build[i]];
+        const auto top_left = config::chunk_size * get_chunk_pos(w, to_build[i]);
+        colliders[i].emplace(compute_collider(w, c, top_left, std::exchange(c.collider_pending, chunk_rect{})));
+        c.stats.begin(w.tick).collider_ms += elapsed_ms(start);
+    });
+    {
+        const auto apply_zone = profile_zone{"apply_chunk_colliders"};
+        for (std::size_t i = 0; i != to_build.size(); ++i) {
+            const auto start = clock::now();
+            auto& c = w.chunks[to_build[i]];
+            apply_chunk_collider(w, c, std::move(*colliders[i]));
+            c.stats.collider_ms += elapsed_ms(start);
+        }
+    }
+
+    // Disabled bodies have no broadphase proxies or contacts, so far away chunks cost the
+    // step nothing
+    for (const auto index : near) {
+        auto& c = w.chunks[index];
+        if (c.triangles && !w.physics_enabled.test(index)) {
+            c.triangles->SetEnabled(true);
+            w.physics_enabled.set(index);
+        }
+    }
+    for (auto index = w.physics_enabled.find_last(w.chunks.size()); index != chunk_bitset::npos; index = w.physics_enabled.find_last(index)) {
+        if (!is_near_any(centres, get_chunk_pos(w, index), config::physics_disable_distance)) {
+            w.chunks[index].triangles->SetEnabled(false);
+            w.physics_enabled.reset(index);
+        }
+    }
+
+    // The contact list only holds pairs whose bounding boxes overlap, so counting it costs
+    // as much as the contacts themselves
+    auto touching = 0;
+    for (auto contact = w.physics.GetContactList(); contact; contact = contact->GetNext()) {
+        if (contact->IsTouching()) ++touching;
+    }
+    const auto extra = touching / config::contacts_per_iteration;
+    const auto step_zone = profile_zone{"b2World::Step"};
+    w.physics.Step(
+        config::time_step,
+        std::min(config::min_velocity_iterations + extra, config::max_velocity_iterations),
+        std::min(config::min_position_iterations + extra, config::max_position_iterations)
+    );
+}
+
+auto island_collider_shapes(const chunk_bitboard& island, glm::ivec2 top_left, std::pmr::memory_resource* scratch) -> std::pmr::vector<collider_shape>
+{
+    return island_shapes(get_island_outline(island, top_left, scratch), collider_mode::convex);
+}
+
+auto count_fixtures(const world& w) -> int
+{
+    auto count = std::size_t{0};
+    for (const auto& c : w.chunks) {
+        for (const auto& island : c.islands) {
+            count += island.fixtures.size();
+        }
+    }
+    return static_cast<int>(count);
 }
-    
 
 }
\ No newline at end of file
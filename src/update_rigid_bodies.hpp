@@ -1,10 +1,60 @@
 #pragma once
 #include <glm/glm.hpp>
 
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
+
+class b2Fixture;
+
 namespace sand {
 
 class world;
+class thread_pool;
 class chunk;
-auto create_chunk_triangles(world& w, chunk& c, glm::ivec2 top_left) -> void;
+struct chunk_bitboard;
+enum class collider_mode;
+
+// A convex polygon, or for chains a closed loop, in world pixel coordinates wound anticlockwise
+using collider_shape = std::pmr::vector<glm::ivec2>;
+
+// The changes to a chunk's collider worked out from its pixels, waiting to be made to
+// the physics world. These live in the scratch arena of the thread that worked them out,
+// so they must be applied within the same tick.
+struct chunk_collider_update
+{
+    collider_mode                                                            mode;
+    std::pmr::vector<std::pair<std::size_t, std::pmr::vector<collider_shape>>> new_shapes; // By island
+    std::pmr::vector<b2Fixture*>                                             to_destroy;
+
+    chunk_collider_update(collider_mode m, std::pmr::memory_resource* scratch)
+        : mode{m}, new_shapes{scratch}, to_destroy{scratch}
+    {}
+};
+
+// Creates and destroys the fixtures worked out for a chunk. Box2D is not thread safe, so
+// this must be called serially.
+auto apply_chunk_collider(world& w, chunk& c, chunk_collider_update&& update) -> void;
+
+// Steps the physics world. Only chunks within config::physics_distance of a dynamic body
+// take part: the colliders of chunks stepped while no body was near are built once one
+// comes close, and the bodies of chunks left behind are disabled. The solver iterations
+// grow with the number of touching contacts, so the cost follows the dynamic bodies
+// rather than the size of the world.
+auto update_physics(world& w, thread_pool& pool, std::span<const std::size_t> stepped) -> void;
+
+// Throws away every collider and builds them again from scratch, such as after changing
+// the collider mode of the world. Those far from any dynamic body are disabled again by
+// the next update_physics.
+auto rebuild_colliders(world& w) -> void;
+
+// The convex shapes of an island in a chunk sized box with the given top left, in pixel
+// coordinates, for building bodies other than the chunk colliders
+auto island_collider_shapes(const chunk_bitboard& island, glm::ivec2 top_left, std::pmr::memory_resource* scratch) -> std::pmr::vector<collider_shape>;
+
+// The number of fixtures making up the colliders of the chunks
+auto count_fixtures(const world& w) -> int;
 
-}
\ No newline at end of file
+}
@@ -1,13 +1,16 @@
 #include "utility.hpp"
-#include "camera.hpp"
-#include "graphics/window.hpp"
 
 #include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
 #include <random>
 #include <numbers>
 #include <iostream>
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 namespace sand {
 
@@ -40,22 +43,122 @@ auto timer::now() const -> clock::time_point
     return d_clock.now();
 }
 
+namespace {
+
+auto splitmix64(std::uint64_t& x) -> std::uint64_t
+{
+    auto z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256**, a lot cheaper than std::default_random_engine and the distributions
+// built on top of it. Still usable with the standard distributions where needed.
+class xoshiro256
+{
+    std::array<std::uint64_t, 4> d_state;
+    std::uint64_t                d_draws = 0;
+
+public:
+    using result_type = std::uint64_t;
+
+    explicit xoshiro256(std::uint64_t seed) { reseed(seed); }
+
+    auto reseed(std::uint64_t seed) -> void
+    {
+        for (auto& s : d_state) { s = splitmix64(seed); }
+    }
+
+    static constexpr auto min() -> result_type { return 0; }
+    static constexpr auto max() -> result_type { return ~result_type{0}; }
+
+    auto draws() const -> std::uint64_t { return d_draws; }
+
+    auto operator()() -> result_type
+    {
+        ++d_draws;
+        const auto result = std::rotl(d_state[1] * 5, 7) * 9;
+        const auto t = d_state[1] << 17;
+        d_state[2] ^= d_state[0];
+        d_state[3] ^= d_state[1];
+        d_state[1] ^= d_state[2];
+        d_state[0] ^= d_state[3];
+        d_state[2] ^= t;
+        d_state[3] = std::rotl(d_state[3], 45);
+        return result;
+    }
+};
+
+// Each thread gets its own engine so the update can call these from worker threads
+auto generator() -> xoshiro256&
+{
+    static thread_local auto gen = xoshiro256{std::random_device{}()};
+    return gen;
+}
+
+// The top 24 bits as a float in [0, 1)
+auto to_unit(std::uint64_t bits) -> float
+{
+    return static_cast<float>(bits >> 40) * 0x1p-24f;
+}
+
+}
+
+auto random_seed(std::uint64_t seed) -> void
+{
+    generator().reseed(seed);
+}
+
+auto random_bits() -> std::uint64_t
+{
+    return generator()();
+}
+
+auto random_draws() -> std::uint64_t
+{
+    return generator().draws();
+}
+
+auto hash_word(std::uint64_t hash, std::uint64_t word) -> std::uint64_t
+{
+    return (std::rotl(hash, 27) ^ word) * 0x9e3779b97f4a7c15;
+}
+
+auto hash_bytes(std::uint64_t hash, std::span<const std::byte> bytes) -> std::uint64_t
+{
+    while (bytes.size() >= sizeof(std::uint64_t)) {
+        auto word = std::uint64_t{0};
+        std::memcpy(&word, bytes.data(), sizeof(word));
+        hash = hash_word(hash, word);
+        bytes = bytes.subspan(sizeof(word));
+    }
+    for (const auto byte : bytes) {
+        hash = hash_word(hash, std::to_integer<std::uint64_t>(byte));
+    }
+    return hash;
+}
+
 auto random_from_range(float min, float max) -> float
 {
-    static std::default_random_engine gen;
-    return std::uniform_real_distribution(min, max)(gen);
+    return min + to_unit(generator()()) * (max - min);
 }
 
 auto random_from_range(int min, int max) -> int
 {
-    static std::default_random_engine gen;
-    return std::uniform_int_distribution(min, max)(gen);
+    // Multiply-shift maps 32 random bits onto the range without a division
+    const auto range = static_cast<std::uint64_t>(max - min) + 1;
+    return min + static_cast<int>(((generator()() >> 32) * range) >> 32);
 }
 
+// Box-Muller on the generator's own output, since std::normal_distribution is implemented
+// differently by each standard library and seeded runs have to agree across them
 auto random_normal(float centre, float sd) -> float
 {
-    static std::default_random_engine gen;
-    return std::normal_distribution(centre, sd)(gen);
+    const auto u1 = 1.0f - to_unit(generator()()); // In (0, 1] so the log is finite
+    const auto u2 = to_unit(generator()());
+    const auto z = std::sqrt(-2.0f * std::log(u1)) * std::cos(2.0f * std::numbers::pi_v<float> * u2);
+    return centre + sd * z;
 }
 
 auto random_from_circle(float radius) -> glm::ivec2
@@ -67,7 +170,7 @@ auto random_from_circle(float radius) -> glm::ivec2
 
 auto coin_flip() -> bool
 {
-    return random_from_range(0, 1) == 0;
+    return generator()() >> 63;
 }
 
 auto sign_flip() -> int
@@ -77,7 +180,7 @@ auto sign_flip() -> int
 
 auto random_unit() -> float
 {
-    return random_from_range(0.0f, 1.0f);
+    return to_unit(generator()());
 }
 
 auto _print_inner(const std::string& msg) -> void
@@ -101,6 +204,7 @@ auto from_hex(int hex) -> glm::vec4
 
 auto get_executable_filepath() -> std::filesystem::path
 {
+#ifdef _WIN32
     auto buffer = std::vector<char>{};
     buffer.resize(16);
     while (true) {
@@ -110,16 +214,9 @@ auto get_executable_filepath() -> std::filesystem::path
         }
         buffer.resize(2 * buffer.size());
     }
-}
-
-auto mouse_pos_world_space(const sand::window& w, const sand::camera& c) -> glm::vec2
-{
-    return w.get_mouse_pos() / c.world_to_screen + c.top_left;
-}
-
-auto pixel_at_mouse(const sand::window& w, const sand::camera& c) -> glm::ivec2
-{
-    return glm::ivec2{mouse_pos_world_space(w, c)};
+#else
+    return std::filesystem::read_symlink("/proc/self/exe");
+#endif
 }
 
 auto pixel_to_physics(glm::vec2 px) -> b2Vec2
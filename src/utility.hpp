@@ -1,7 +1,9 @@
 #pragma once
+#include <algorithm>
 #include <chrono>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <span>
 #include <format>
@@ -80,8 +82,45 @@ auto coin_flip() -> bool;
 auto sign_flip() -> int;
 auto random_unit() -> float; // Same as random_from_range(0.0f, 1.0f)
 
+// Each thread has its own generator, seeded from std::random_device on first use. Reseeding
+// makes the calling thread's sequence reproducible.
+auto random_seed(std::uint64_t seed) -> void;
+
+auto random_bits() -> std::uint64_t; // 64 independent coin flips, for hot loops
+
+// The words drawn from the calling thread's generator so far, for telemetry
+auto random_draws() -> std::uint64_t;
+
+// Folds a word or a run of bytes into a running hash. Well mixed enough to tell two runs of
+// the simulation apart, nothing more.
+auto hash_word(std::uint64_t hash, std::uint64_t word) -> std::uint64_t;
+auto hash_bytes(std::uint64_t hash, std::span<const std::byte> bytes) -> std::uint64_t;
+
 auto from_hex(int hex) -> glm::vec4;
 
+// Packs a colour into four bytes with red in the lowest byte, which is the layout that
+// GL_RGBA with GL_UNSIGNED_BYTE expects on little endian machines
+inline auto to_rgba8(const glm::vec4& colour) -> std::uint32_t
+{
+    const auto channel = [](float c) {
+        return static_cast<std::uint32_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+    };
+    return channel(colour.x)
+        | (channel(colour.y) << 8)
+        | (channel(colour.z) << 16)
+        | (channel(colour.w) << 24);
+}
+
+inline auto from_rgba8(std::uint32_t rgba) -> glm::vec4
+{
+    return glm::vec4{
+        static_cast<float>(rgba & 0xff),
+        static_cast<float>((rgba >> 8) & 0xff),
+        static_cast<float>((rgba >> 16) & 0xff),
+        static_cast<float>((rgba >> 24) & 0xff)
+    } / 255.0f;
+}
+
 auto get_executable_filepath() -> std::filesystem::path;
 
 template <typename T>
@@ -90,11 +129,6 @@ auto lerp(const T& a, const T& b, float t) -> T
     return t * b + (1 - t) * a;
 };
 
-class window;
-struct camera;
-auto mouse_pos_world_space(const window& w, const camera& c) -> glm::vec2;
-auto pixel_at_mouse(const window& w, const camera& c) -> glm::ivec2;
-
 auto pixel_to_physics(glm::vec2 px) -> b2Vec2;
 auto pixel_to_physics(float px) -> float;
 
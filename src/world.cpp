@@ -3,8 +3,13 @@
 #include "update.hpp"
 #include "utility.hpp"
 
+#include <atomic>
 #include <cassert>
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <print>
 #include <ranges>
 
 namespace sand {
@@ -12,23 +17,391 @@ namespace {
 
 static const auto default_pixel = pixel::air();
 
+// Released pages kept around for reuse, enough to cover the chunks woken by a big blast
+static constexpr auto max_free_pages = std::size_t{64};
+
+auto is_air(const pixel& px) -> bool
+{
+    return px.type == default_pixel.type
+        && to_rgba8(px.colour) == to_rgba8(default_pixel.colour)
+        && px.velocity == default_pixel.velocity
+        && px.power == default_pixel.power;
+}
+
+// What a chunk that was never written to reads as
+auto air_page() -> chunk_page&
+{
+    static const auto page = [] {
+        auto p = std::make_unique<chunk_page>();
+        p->type.fill(default_pixel.type);
+        p->colour.fill(to_rgba8(default_pixel.colour));
+        p->velocity.fill(default_pixel.velocity);
+        p->power.fill(default_pixel.power);
+        return p;
+    }();
+    return *page;
+}
+
+auto is_air(const chunk_page& page) -> bool
+{
+    return page.type == air_page().type
+        && page.colour == air_page().colour
+        && page.velocity == air_page().velocity
+        && page.power == air_page().power;
+}
+
+auto atomic_min(int& value, int x) -> void
+{
+    auto ref = std::atomic_ref{value};
+    auto curr = ref.load(std::memory_order_relaxed);
+    while (x < curr && !ref.compare_exchange_weak(curr, x, std::memory_order_relaxed)) {}
+}
+
+auto atomic_max(int& value, int x) -> void
+{
+    auto ref = std::atomic_ref{value};
+    auto curr = ref.load(std::memory_order_relaxed);
+    while (x > curr && !ref.compare_exchange_weak(curr, x, std::memory_order_relaxed)) {}
+}
+
+// For each chunk local coordinate, whether waking it along with its neighbours spills into
+// the chunk before or after on that axis
+constexpr auto border_spill = [] {
+    auto table = std::array<int, config::chunk_size>{};
+    table.front() = -1;
+    table.back() = 1;
+    return table;
+}();
+
+}
+
+pixel_world::pixel_world(std::size_t width, std::size_t height)
+    : d_pages((width / config::chunk_size) * (height / config::chunk_size))
+    , d_page_file(d_pages.size())
+    , d_page_mutexes(d_pages.size())
+    , d_boards(d_pages.size())
+    , d_width{width}
+    , d_height{height}
+{
+    assert(width % config::chunk_size == 0);
+    assert(height % config::chunk_size == 0);
+    fill(default_pixel);
 }
 
-auto pixel_world::valid(glm::ivec2 pos) const -> bool
+pixel_world::~pixel_world()
 {
-    return 0 <= pos.x && pos.x < d_width && 0 <= pos.y && pos.y < d_height;
+    for (auto& page : d_pages) {
+        delete page.load(std::memory_order_relaxed);
+    }
 }
 
-auto pixel_world::operator[](glm::ivec2 pos) -> pixel&
+auto pixel_world::fault(std::size_t chunk, bool writing) const -> chunk_page*
 {
-    assert(valid(pos));
-    return d_pixels[pos.x + d_width * pos.y];
+    const auto lock = std::scoped_lock{d_page_mutexes[chunk]};
+    if (const auto page = d_pages[chunk].load(std::memory_order_acquire)) return page;
+
+    const auto paged_out = d_page_file.contains(chunk);
+    if (!paged_out && !writing) return &air_page();
+
+    auto page = allocate_page();
+    if (!paged_out) {
+        *page = air_page();
+    } else if (decode_page(d_page_file.read(chunk), *page, nullptr)) {
+        d_page_file.erase(chunk);
+    } else {
+        // The block is kept, so a read tries again next time. A write has to go somewhere,
+        // so the chunk becomes resident as air and its next page out replaces the block.
+        std::print("Could not page in chunk {}\n", chunk);
+        if (!writing) {
+            release_page(std::move(page));
+            return &air_page();
+        }
+        *page = air_page();
+    }
+    d_pages[chunk].store(page.get(), std::memory_order_release);
+    return page.release();
 }
 
-auto pixel_world::operator[](glm::ivec2 pos) const -> const pixel&
+auto pixel_world::allocate_page() const -> std::unique_ptr<chunk_page>
 {
-    assert(valid(pos));
-    return d_pixels[pos.x + d_width * pos.y];
+    const auto lock = std::scoped_lock{d_free_pages_mutex};
+    if (d_free_pages.empty()) {
+        return std::make_unique<chunk_page>();
+    }
+    auto page = std::move(d_free_pages.back());
+    d_free_pages.pop_back();
+    return page;
+}
+
+auto pixel_world::release_page(std::unique_ptr<chunk_page> page) const -> void
+{
+    const auto lock = std::scoped_lock{d_free_pages_mutex};
+    if (d_free_pages.size() < max_free_pages) {
+        d_free_pages.push_back(std::move(page));
+    }
+}
+
+auto pixel_world::set(std::size_t i, const pixel& px) -> void
+{
+    auto& page = write_page(i / chunk_page::size);
+    const auto j = i % chunk_page::size;
+    set_type(i, px.type);
+    page.colour[j] = to_rgba8(px.colour);
+    page.velocity[j] = px.velocity;
+    set_packed_flags(i, static_cast<std::uint8_t>(px.flags.to_ullong()));
+    page.power[j] = px.power;
+}
+
+auto pixel_world::set_type(std::size_t i, pixel_type type) -> void
+{
+    const auto chunk = i / chunk_page::size;
+    const auto j = i % chunk_page::size;
+    auto& page = write_page(chunk);
+    auto& boards = d_boards[chunk];
+    if (is_circuit_pixel(page.type[j]) || is_circuit_pixel(type)) {
+        boards.circuit.set(local_position(j), is_circuit_pixel(type));
+        std::atomic_ref{d_circuit_version}.fetch_add(1, std::memory_order_relaxed);
+    }
+    page.type[j] = type;
+    boards.occupied.set(local_position(j), type != pixel_type::none);
+    boards.awake_types.set(local_position(j), hot_properties(type).has(pixel_trait::always_awake));
+}
+
+auto pixel_world::set_row(glm::ivec2 start, std::span<const pixel> row) -> void
+{
+    const auto local = start % config::chunk_size;
+    assert(local.x + row.size() <= config::chunk_size);
+    if (row.empty()) return;
+
+    const auto chunk = chunk_index(start);
+    const auto first = local_index(start);
+    auto& page = write_page(chunk);
+
+    // Each board gets the bits of the run in one go
+    auto occupied = std::uint64_t{0};
+    auto circuit = std::uint64_t{0};
+    auto awake = std::uint64_t{0};
+    auto flags = std::array<std::uint64_t, num_pixel_flags>{};
+    auto circuit_changed = false;
+    for (std::size_t i = 0; i != row.size(); ++i) {
+        const auto& px = row[i];
+        const auto j = first + i;
+        const auto bit = std::uint64_t{1} << (local.x + i);
+        circuit_changed |= is_circuit_pixel(page.type[j]) || is_circuit_pixel(px.type);
+
+        page.type[j] = px.type;
+        page.colour[j] = to_rgba8(px.colour);
+        page.velocity[j] = px.velocity;
+        page.power[j] = px.power;
+
+        if (px.type != pixel_type::none) occupied |= bit;
+        if (is_circuit_pixel(px.type)) circuit |= bit;
+        if (hot_properties(px.type).has(pixel_trait::always_awake)) awake |= bit;
+        for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+            if (px.flags[flag]) flags[flag] |= bit;
+        }
+    }
+
+    const auto run = (row.size() == 64 ? ~std::uint64_t{0} : ((std::uint64_t{1} << row.size()) - 1)) << local.x;
+    const auto write = [&](chunk_bitboard& board, std::uint64_t bits) {
+        atomic_set_bits(board.rows[local.y], run & ~bits, false);
+        atomic_set_bits(board.rows[local.y], bits, true);
+    };
+    auto& boards = d_boards[chunk];
+    write(boards.occupied, occupied);
+    write(boards.circuit, circuit);
+    write(boards.awake_types, awake);
+    for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+        write(boards.flags[flag], flags[flag]);
+    }
+    if (circuit_changed) {
+        std::atomic_ref{d_circuit_version}.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+auto pixel_world::swap(glm::ivec2 a, glm::ivec2 b) -> void
+{
+    const auto chunk_a = chunk_index(a);
+    const auto chunk_b = chunk_index(b);
+    auto& page_a = write_page(chunk_a);
+    auto& page_b = write_page(chunk_b);
+    const auto i = local_index(a);
+    const auto j = local_index(b);
+    if (is_circuit_pixel(page_a.type[i]) || is_circuit_pixel(page_b.type[j])) {
+        std::atomic_ref{d_circuit_version}.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::swap(page_a.type[i], page_b.type[j]);
+    std::swap(page_a.colour[i], page_b.colour[j]);
+    std::swap(page_a.velocity[i], page_b.velocity[j]);
+    std::swap(page_a.power[i], page_b.power[j]);
+
+    auto& boards_a = d_boards[chunk_a];
+    auto& boards_b = d_boards[chunk_b];
+    const auto local_a = a % config::chunk_size;
+    const auto local_b = b % config::chunk_size;
+    const auto swap_bits = [&](chunk_bitboard& board_a, chunk_bitboard& board_b) {
+        const auto bit_a = board_a.test(local_a);
+        board_a.set(local_a, board_b.test(local_b));
+        board_b.set(local_b, bit_a);
+    };
+    swap_bits(boards_a.occupied, boards_b.occupied);
+    swap_bits(boards_a.circuit, boards_b.circuit);
+    swap_bits(boards_a.awake_types, boards_b.awake_types);
+    for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+        swap_bits(boards_a.flags[flag], boards_b.flags[flag]);
+    }
+}
+
+auto pixel_world::fill(const pixel& px) -> void
+{
+    // Filling with air just drops every page
+    d_page_file.clear();
+    for (std::size_t chunk = 0; chunk != d_pages.size(); ++chunk) {
+        if (const auto page = d_pages[chunk].exchange(nullptr, std::memory_order_acq_rel)) {
+            release_page(std::unique_ptr<chunk_page>{page});
+        }
+    }
+    if (!is_air(px)) {
+        for (std::size_t chunk = 0; chunk != d_pages.size(); ++chunk) {
+            auto& page = write_page(chunk);
+            page.type.fill(px.type);
+            page.colour.fill(to_rgba8(px.colour));
+            page.velocity.fill(px.velocity);
+            page.power.fill(px.power);
+        }
+    }
+    ++d_circuit_version;
+
+    const auto row = [](bool value) { return value ? ~std::uint64_t{0} : std::uint64_t{0}; };
+    for (auto& boards : d_boards) {
+        boards.occupied.rows.fill(row(px.type != pixel_type::none));
+        boards.circuit.rows.fill(row(is_circuit_pixel(px.type)));
+        boards.awake_types.rows.fill(row(hot_properties(px.type).has(pixel_trait::always_awake)));
+        for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+            boards.flags[flag].rows.fill(row(px.flags[flag]));
+        }
+    }
+}
+
+auto pixel_world::reset_flag(pixel_flags flag) -> void
+{
+    for (auto& boards : d_boards) {
+        boards.flags[flag].clear();
+    }
+}
+
+auto pixel_world::reset_flag(std::size_t chunk, pixel_flags flag) -> void
+{
+    d_boards[chunk].flags[flag].clear();
+}
+
+auto pixel_world::packed_flags(std::size_t i) const -> std::uint8_t
+{
+    const auto& boards = d_boards[i / chunk_page::size];
+    const auto local = local_position(i % chunk_page::size);
+    auto bits = std::uint8_t{0};
+    for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+        bits |= static_cast<std::uint8_t>(boards.flags[flag].test(local) << flag);
+    }
+    return bits;
+}
+
+auto pixel_world::set_packed_flags(std::size_t i, std::uint8_t bits) -> void
+{
+    auto& boards = d_boards[i / chunk_page::size];
+    const auto local = local_position(i % chunk_page::size);
+    for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+        boards.flags[flag].set(local, (bits >> flag) & 1u);
+    }
+}
+
+auto pixel_world::encode_chunk(std::size_t chunk) const -> std::vector<std::byte>
+{
+    {
+        const auto lock = std::scoped_lock{d_page_mutexes[chunk]};
+        if (is_paged_out(chunk)) {
+            if (auto block = d_page_file.read(chunk); !block.empty()) return block;
+        }
+    }
+    return encode_page(page(chunk), d_boards[chunk]);
+}
+
+auto pixel_world::decode_chunk(std::size_t chunk, std::span<const std::byte> block) -> bool
+{
+    auto& page = write_page(chunk);
+    if (!decode_page(block, page, &d_boards[chunk])) return false;
+    if (d_boards[chunk].circuit.any()) {
+        std::atomic_ref{d_circuit_version}.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (is_air(page)) {
+        release_page(std::unique_ptr<chunk_page>{d_pages[chunk].exchange(nullptr, std::memory_order_acq_rel)});
+    }
+    return true;
+}
+
+auto pixel_world::hash_chunk(std::size_t chunk) const -> std::uint64_t
+{
+    auto decoded = std::unique_ptr<chunk_page>{};
+    {
+        const auto lock = std::scoped_lock{d_page_mutexes[chunk]};
+        if (is_paged_out(chunk)) {
+            decoded = std::make_unique<chunk_page>();
+            if (!decode_page(d_page_file.read(chunk), *decoded, nullptr)) {
+                std::print("Could not read chunk {} to hash it\n", chunk);
+                *decoded = air_page();
+            }
+        }
+    }
+    const auto& p = decoded ? *decoded : page(chunk);
+
+    auto h = hash_bytes(0, std::as_bytes(std::span{p.type}));
+    h = hash_bytes(h, std::as_bytes(std::span{p.colour}));
+    h = hash_bytes(h, std::as_bytes(std::span{p.velocity}));
+    h = hash_bytes(h, std::as_bytes(std::span{p.power}));
+    for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+        if (flag == is_updated) continue;
+        for (int y = 0; y != config::chunk_size; ++y) {
+            h = hash_word(h, d_boards[chunk].flags[flag].row(y));
+        }
+    }
+    return h;
+}
+
+auto pixel_world::page_out(std::size_t chunk) -> void
+{
+    const auto lock = std::scoped_lock{d_page_mutexes[chunk]};
+    auto page = std::unique_ptr<chunk_page>{d_pages[chunk].exchange(nullptr, std::memory_order_acq_rel)};
+    if (!page) return;
+    if (is_air(*page)) {
+        d_page_file.erase(chunk); // Left over from a block that failed to page in
+    } else {
+        d_page_file.write(chunk, encode_page(*page, d_boards[chunk]));
+    }
+    release_page(std::move(page));
+}
+
+auto pixel_world::num_resident_pages() const -> std::size_t
+{
+    return std::ranges::count_if(d_pages, [](const auto& page) {
+        return page.load(std::memory_order_relaxed) != nullptr;
+    });
+}
+
+auto pixel_world::num_paged_out() const -> std::size_t
+{
+    return d_page_file.size();
+}
+
+auto pixel_world::to_vector() const -> std::vector<pixel>
+{
+    auto pixels = std::vector<pixel>{};
+    pixels.reserve(d_width * d_height);
+    for (std::size_t y = 0; y != d_height; ++y) {
+        for (std::size_t x = 0; x != d_width; ++x) {
+            pixels.push_back((*this)[{x, y}]);
+        }
+    }
+    return pixels;
 }
 
 auto get_chunk_index(const world& w, glm::ivec2 chunk) -> std::size_t
@@ -48,47 +421,154 @@ world::world(std::size_t width, std::size_t height)
     , pixels{width, height}
     , spawn_point{width / 2, height / 2}
     , player{physics, 5}
+    , awake{(width / config::chunk_size) * (height / config::chunk_size)}
+    , stepping{(width / config::chunk_size) * (height / config::chunk_size)}
+    , ticking{(width / config::chunk_size) * (height / config::chunk_size)}
+    , unsaved{(width / config::chunk_size) * (height / config::chunk_size)}
+    , physics_enabled{(width / config::chunk_size) * (height / config::chunk_size)}
 {
     assert(width % config::chunk_size == 0);
     assert(height % config::chunk_size == 0);
     const auto width_chunks = width / config::chunk_size;
     const auto height_chunks = height / config::chunk_size;
     chunks.resize(width_chunks * height_chunks);
+
+    // New chunks start with everything dirty
+    for (std::size_t index = 0; index != chunks.size(); ++index) {
+        awake.set(index);
+        stepping.set(index);
+        unsaved.set(index);
+    }
 }
 
+// Most pixels are away from the chunk borders, so their neighbours are all in the same
+// chunk and only its rect needs growing
 auto world::wake_chunk_with_pixel(glm::ivec2 pixel) -> void
 {
-    const auto chunk = pixel / sand::config::chunk_size;
-    chunks[get_chunk_index(*this, chunk)].should_step_next = true;
-    const auto width_pixels = static_cast<int>(pixels.width());
+    const auto local = pixel % config::chunk_size;
+    if (border_spill[local.x] | border_spill[local.y]) {
+        wake_region(pixel, pixel);
+        return;
+    }
+    wake_chunk(get_chunk_index(*this, pixel / config::chunk_size), local - 1, local + 1);
+}
+
+// Chunks can be woken from several worker threads at once when the update runs in
+// parallel, so the rect is always grown atomically
+auto world::wake_chunk(std::size_t index, glm::ivec2 min, glm::ivec2 max) -> void
+{
+    auto& c = chunks[index];
+    atomic_min(c.dirty_next.min.x, min.x);
+    atomic_min(c.dirty_next.min.y, min.y);
+    atomic_max(c.dirty_next.max.x, max.x);
+    atomic_max(c.dirty_next.max.y, max.y);
+    awake.set(index);
+    unsaved.set(index);
+}
 
-    // Wake right
-    if (pixel.x != width_pixels - 1 && (pixel.x + 1) % sand::config::chunk_size == 0)
-    {
-        const auto neighbour = chunk + glm::ivec2{1, 0};
-        if (pixels.valid(neighbour)) { chunks[get_chunk_index(*this, neighbour)].should_step_next = true; }
+auto world::wake_all() -> void
+{
+    for (std::size_t index = 0; index != chunks.size(); ++index) {
+        chunks[index].dirty_next = chunk_rect::full();
+        awake.set(index);
+        unsaved.set(index);
     }
+}
 
-    // Wake left
-    if (pixel.x != 0 && (pixel.x - 1) % sand::config::chunk_size == 0)
-    {
-        const auto neighbour = chunk - glm::ivec2{1, 0};
-        if (pixels.valid(neighbour)) { chunks[get_chunk_index(*this, neighbour)].should_step_next = true; }
+auto world::wake_region(glm::ivec2 min, glm::ivec2 max) -> void
+{
+    // The region and its neighbours, which may spill over into the surrounding chunks
+    const auto lo = glm::max(min - 1, glm::ivec2{0, 0});
+    const auto hi = glm::min(max + 1, glm::ivec2{pixels.width() - 1, pixels.height() - 1});
+
+    const auto chunk_lo = lo / config::chunk_size;
+    const auto chunk_hi = hi / config::chunk_size;
+    for (int y = chunk_lo.y; y <= chunk_hi.y; ++y) {
+        for (int x = chunk_lo.x; x <= chunk_hi.x; ++x) {
+            const auto top_left = config::chunk_size * glm::ivec2{x, y};
+            const auto bottom_right = top_left + config::chunk_size - 1;
+            wake_chunk(
+                get_chunk_index(*this, {x, y}),
+                glm::max(lo, top_left) - top_left,
+                glm::min(hi, bottom_right) - top_left
+            );
+        }
     }
+}
 
-    // Wake down
-    if (pixel.y != width_pixels - 1 && (pixel.y + 1) % sand::config::chunk_size == 0)
-    {
-        const auto neighbour = chunk + glm::ivec2{0, 1};
-        if (pixels.valid(neighbour)) { chunks[get_chunk_index(*this, neighbour)].should_step_next = true; }
+namespace {
+
+// Writes a row of the shapes below without waking it, so each shape is woken once at the
+// end. Returns false if the row is outside of the world.
+auto write_span(pixel_world& pixels, int y, int x_min, int x_max, const pixel_maker& make) -> bool
+{
+    if (y < 0 || y >= static_cast<int>(pixels.height())) return false;
+    x_min = std::max(x_min, 0);
+    x_max = std::min(x_max, static_cast<int>(pixels.width()) - 1);
+    if (x_min > x_max) return false;
+
+    auto row = std::array<pixel, config::chunk_size>{};
+    for (int x = x_min; x <= x_max;) {
+        const auto end = std::min(x_max + 1, (x / config::chunk_size + 1) * config::chunk_size);
+        const auto count = static_cast<std::size_t>(end - x);
+        for (std::size_t i = 0; i != count; ++i) {
+            row[i] = make();
+        }
+        pixels.set_row({x, y}, std::span{row}.first(count));
+        x = end;
     }
+    return true;
+}
 
-    // Wake up
-    if (pixel.y != 0 && (pixel.y - 1) % sand::config::chunk_size == 0)
-    {
-        const auto neighbour = chunk - glm::ivec2{0, 1};
-        if (pixels.valid(neighbour)) { chunks[get_chunk_index(*this, neighbour)].should_step_next = true; }
+}
+
+auto world::fill_span(int y, int x_min, int x_max, const pixel_maker& make) -> void
+{
+    if (write_span(pixels, y, x_min, x_max, make)) {
+        wake_region({std::max(x_min, 0), y}, {std::min(x_max, static_cast<int>(pixels.width()) - 1), y});
+    }
+}
+
+auto world::fill_rect(glm::ivec2 min, glm::ivec2 max, const pixel_maker& make) -> void
+{
+    min = glm::max(min, glm::ivec2{0, 0});
+    max = glm::min(max, glm::ivec2{pixels.width() - 1, pixels.height() - 1});
+    if (min.x > max.x || min.y > max.y) return;
+
+    for (int y = min.y; y <= max.y; ++y) {
+        write_span(pixels, y, min.x, max.x, make);
+    }
+    wake_region(min, max);
+}
+
+auto world::fill_circle(glm::ivec2 centre, float radius, const pixel_maker& make) -> void
+{
+    if (radius < 0.0f) return;
+    const auto extent = static_cast<int>(radius);
+    for (int dy = -extent; dy <= extent; ++dy) {
+        const auto half_width = static_cast<int>(std::sqrt(radius * radius - dy * dy));
+        write_span(pixels, centre.y + dy, centre.x - half_width, centre.x + half_width, make);
+    }
+
+    const auto min = glm::max(centre - extent, glm::ivec2{0, 0});
+    const auto max = glm::min(centre + extent, glm::ivec2{pixels.width() - 1, pixels.height() - 1});
+    if (min.x <= max.x && min.y <= max.y) {
+        wake_region(min, max);
     }
 }
 
+auto world::redraw_pixel(glm::ivec2 pixel) -> void
+{
+    const auto index = get_chunk_index(*this, pixel / config::chunk_size);
+    const auto local = pixel % config::chunk_size;
+    chunks[index].redraw = merge(chunks[index].redraw, chunk_rect{local, local});
+    unsaved.set(index);
+}
+
+auto world::queue_explosion(glm::vec2 pos, const explosion& info) -> void
+{
+    const auto lock = std::scoped_lock{queued_explosions_mutex};
+    queued_explosions.emplace_back(pos, info);
+}
+
 }
\ No newline at end of file
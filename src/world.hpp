@@ -3,11 +3,30 @@
 #include "serialise.hpp"
 #include "config.hpp"
 #include "world_save.hpp"
+#include "page_file.hpp"
 #include "player.hpp"
+#include "explosion.hpp"
+#include "circuit.hpp"
 
+#include "utility.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <bitset>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
 #include <unordered_set>
 #include <array>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
@@ -16,51 +35,544 @@
 
 namespace sand {
 
+// An inclusive rectangle of pixels in chunk local coordinates. Empty when min > max.
+struct chunk_rect
+{
+    glm::ivec2 min = {config::chunk_size, config::chunk_size};
+    glm::ivec2 max = {-1, -1};
+
+    static auto full() -> chunk_rect
+    {
+        return {{0, 0}, {config::chunk_size - 1, config::chunk_size - 1}};
+    }
+
+    auto empty() const -> bool { return min.x > max.x || min.y > max.y; }
+
+    // The columns of the rect as a mask over a chunk_bitboard row, zero when empty
+    auto columns() const -> std::uint64_t
+    {
+        if (empty()) return 0;
+        const auto all = ~std::uint64_t{0};
+        return (all >> (63 - max.x)) & (all << min.x);
+    }
+};
+
+inline auto merge(const chunk_rect& a, const chunk_rect& b) -> chunk_rect
+{
+    return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+// Sets or reads bits of a word that other threads may be changing other bits of
+inline auto atomic_set_bits(std::uint64_t& word, std::uint64_t mask, bool value) -> void
+{
+    auto ref = std::atomic_ref{word};
+    if (value) { ref.fetch_or(mask, std::memory_order_relaxed); }
+    else       { ref.fetch_and(~mask, std::memory_order_relaxed); }
+}
+
+inline auto atomic_load_bits(const std::uint64_t& word) -> std::uint64_t
+{
+    return std::atomic_ref{const_cast<std::uint64_t&>(word)}.load(std::memory_order_relaxed);
+}
+
+// A bit per pixel of a chunk in chunk local coordinates. Each row is a single word with
+// bit x being column x, so whole rows can be tested and combined at once.
+//
+// Chunks updated in parallel can move pixels into the same neighbour, so they share its
+// rows while touching different bits. Single bit writes and row reads are atomic for that
+// reason, whole board operations are only used between updates.
+struct chunk_bitboard
+{
+    static_assert(config::chunk_size <= 64, "a chunk row must fit in a word");
+
+    std::array<std::uint64_t, config::chunk_size> rows = {};
+
+    auto row(int y) const -> std::uint64_t { return atomic_load_bits(rows[y]); }
+
+    auto test(glm::ivec2 pos) const -> bool { return (row(pos.y) >> pos.x) & 1u; }
+
+    auto set(glm::ivec2 pos, bool value) -> void
+    {
+        atomic_set_bits(rows[pos.y], std::uint64_t{1} << pos.x, value);
+    }
+
+    auto any() const -> bool
+    {
+        for (const auto row : rows) {
+            if (row) return true;
+        }
+        return false;
+    }
+
+    auto any(const chunk_rect& rect) const -> bool
+    {
+        const auto columns = rect.columns();
+        for (int y = rect.min.y; y <= rect.max.y; ++y) {
+            if (row(y) & columns) return true;
+        }
+        return false;
+    }
+
+    auto clear() -> void { rows.fill(0); }
+
+    auto operator^=(const chunk_bitboard& other) -> chunk_bitboard&
+    {
+        for (std::size_t y = 0; y != rows.size(); ++y) {
+            rows[y] ^= other.rows[y];
+        }
+        return *this;
+    }
+
+    auto operator==(const chunk_bitboard&) const -> bool = default;
+};
+
+// A bit per chunk, indexed the same way as world::chunks. Bits can be set and reset from
+// several threads at once, as with chunk_bitboard.
+class chunk_bitset
+{
+    std::vector<std::uint64_t> d_words;
+
+public:
+    static constexpr auto npos = ~std::size_t{0};
+
+    explicit chunk_bitset(std::size_t size) : d_words((size + 63) / 64) {}
+
+    auto test(std::size_t i) const -> bool
+    {
+        return (atomic_load_bits(d_words[i / 64]) >> (i % 64)) & 1u;
+    }
+
+    // Only writes the word when the bit changes, since most wakes land on awake chunks
+    auto set(std::size_t i) -> void
+    {
+        if (!test(i)) atomic_set_bits(d_words[i / 64], std::uint64_t{1} << (i % 64), true);
+    }
+
+    auto reset(std::size_t i) -> void
+    {
+        if (test(i)) atomic_set_bits(d_words[i / 64], std::uint64_t{1} << (i % 64), false);
+    }
+
+    auto clear() -> void { std::ranges::fill(d_words, 0); }
+
+    auto count() const -> std::size_t
+    {
+        auto total = std::size_t{0};
+        for (const auto word : d_words) total += std::popcount(word);
+        return total;
+    }
+
+    // The highest set bit below end, or npos. The words are reread on every call, so bits
+    // set below end in the meantime are found.
+    auto find_last(std::size_t end) const -> std::size_t
+    {
+        while (end != 0) {
+            const auto word = end - 1;
+            auto bits = atomic_load_bits(d_words[word / 64]) & (~std::uint64_t{0} >> (63 - word % 64));
+            if (bits) return (word / 64) * 64 + 63 - std::countl_zero(bits);
+            end = (word / 64) * 64;
+        }
+        return npos;
+    }
+};
+
+// How the static pixels of each chunk are turned into Box2D fixtures. Triangles is a
+// fixture per triangle of the boundary, convex merges those into polygons of up to
+// b2_maxPolygonVertices, and chain is a single b2ChainShape loop around each island.
+enum class collider_mode
+{
+    triangles,
+    convex,
+    chain,
+};
+
+// A connected group of static pixels in a chunk, along with the fixtures built for it
+struct chunk_island
+{
+    chunk_bitboard          pixels;
+    std::vector<b2Fixture*> fixtures;
+};
+
+// Makes the pixels for the bulk fills on world
+using pixel_maker = std::function<pixel()>;
+
+// Line segments in pixel space, the edges of every fixture of a chunk's collider
+using collider_outline = std::vector<std::pair<glm::vec2, glm::vec2>>;
+
+// A piece of the world cut loose by an explosion and handed to Box2D as a dynamic body
+// until it comes to rest, see carve_debris. Its pixels are kept by their offset from the
+// body's origin, which starts at the top left of the island.
+struct debris_pixel
+{
+    glm::ivec2 offset;
+    pixel      px;
+};
+
+struct debris_body
+{
+    b2Body*                                          body;
+    std::shared_ptr<const std::vector<debris_pixel>> pixels;  // Shared with snapshots
+    std::uint64_t                                    created; // The tick it was carved on
+};
+
+// What updating a chunk cost, for the telemetry overlay. The counts are from the tick given
+// and are started again the first time the chunk is counted in a later tick.
+struct chunk_stats
+{
+    std::uint64_t tick         = ~std::uint64_t{0};
+    std::uint32_t pixels       = 0; // Updated
+    std::uint32_t moves        = 0; // Pixels that moved
+    std::uint32_t wakes        = 0; // Pixels woken
+    std::uint32_t random_draws = 0;
+    float         collider_ms  = 0.0f; // Building and applying the collider
+    std::uint32_t fixtures     = 0;    // Only filled in by snapshots
+
+    auto begin(std::uint64_t now) -> chunk_stats&
+    {
+        if (tick != now) *this = {.tick = now};
+        return *this;
+    }
+};
+
 struct chunk
 {
-    bool    should_step      = true;
-    bool    should_step_next = true;
-    b2Body* triangles        = nullptr;
+    // The pixels scanned this step, and the pixels woken during it to be scanned next.
+    // Waking a pixel also wakes its neighbours so anything that may now move gets a look.
+    chunk_rect dirty      = chunk_rect::full();
+    chunk_rect dirty_next = chunk_rect::full();
+
+    // Everything that may have changed since the chunk was last drawn. Each tick adds the
+    // rects above, and pixels that change without needing a scan, such as power levels,
+    // are added directly. The renderer clears it.
+    chunk_rect redraw = chunk_rect::full();
+
+    // Which pixels were static when the collider was last built, only the dirty region
+    // gets refreshed on each rebuild. Islands that come out the same keep their fixtures.
+    chunk_bitboard            static_pixels;
+    std::vector<chunk_island> islands;
+    b2Body*                   triangles = nullptr;
+
+    // The pixels stepped since the collider was last built, which is put off while no
+    // dynamic body is near the chunk
+    chunk_rect collider_pending;
+
+    // Bumped whenever the fixtures of triangles change. The outline drawn for debugging is
+    // built from them on demand and kept until the version moves on.
+    std::uint64_t                           collider_version = 0;
+    std::uint64_t                           outline_version  = ~std::uint64_t{0};
+    std::shared_ptr<const collider_outline> outline;
+
+    chunk_stats stats;
+
+    auto should_step() const -> bool { return !dirty.empty(); }
 };
 
 class world;
 auto get_chunk_index(const world& w, glm::ivec2 chunk) -> std::size_t;
 auto get_chunk_pos(const world& w, std::size_t index) -> glm::ivec2;
 
+// The bitboards pixel_world keeps for each chunk. Occupancy follows the pixel types, and
+// the pixel flags are stored here rather than per pixel so that they can be cleared or
+// scanned a chunk at a time.
+struct chunk_bitboards
+{
+    chunk_bitboard                              occupied; // type != pixel_type::none
+    chunk_bitboard                              circuit;  // is_circuit_pixel(type)
+    chunk_bitboard                              awake_types; // The type is always_awake
+    std::array<chunk_bitboard, num_pixel_flags> flags;    // Indexed by pixel_flags
+};
+
+// Handle to the flags of a pixel stored in a pixel_world, behaving like a bitset
+template <typename Boards>
+class pixel_flags_ref
+{
+    Boards*       d_boards;
+    std::size_t   d_row;
+    std::uint64_t d_mask;
+
+public:
+    class reference
+    {
+        std::uint64_t* d_word;
+        std::uint64_t  d_mask;
+
+    public:
+        reference(std::uint64_t& word, std::uint64_t mask) : d_word{&word}, d_mask{mask} {}
+        operator bool() const { return atomic_load_bits(*d_word) & d_mask; }
+        auto operator=(bool value) -> reference&
+        {
+            atomic_set_bits(*d_word, d_mask, value);
+            return *this;
+        }
+    };
+
+    pixel_flags_ref(Boards& boards, glm::ivec2 local)
+        : d_boards{&boards}
+        , d_row(local.y)
+        , d_mask{std::uint64_t{1} << local.x}
+    {}
+
+    auto test(pixel_flags flag) const -> bool { return d_boards->flags[flag].row(d_row) & d_mask; }
+
+    auto operator[](pixel_flags flag) const
+    {
+        if constexpr (std::is_const_v<Boards>) { return test(flag); }
+        else                                   { return reference{d_boards->flags[flag].rows[d_row], d_mask}; }
+    }
+
+    auto to_bitset() const -> std::bitset<64>
+    {
+        auto bits = std::bitset<64>{};
+        for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+            bits[flag] = test(static_cast<pixel_flags>(flag));
+        }
+        return bits;
+    }
+
+    auto operator=(const std::bitset<64>& bits) const -> const pixel_flags_ref&
+    {
+        for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+            (*this)[static_cast<pixel_flags>(flag)] = bits[flag];
+        }
+        return *this;
+    }
+};
+
+// Handle to the colour of a pixel stored in a pixel_world, which keeps it packed as RGBA8
+template <typename Word>
+class pixel_colour_ref
+{
+    Word* d_rgba;
+
+public:
+    explicit pixel_colour_ref(Word& rgba) : d_rgba{&rgba} {}
+
+    operator glm::vec4() const { return from_rgba8(*d_rgba); }
+    auto rgba() const -> std::uint32_t { return *d_rgba; }
+
+    auto operator=(const glm::vec4& colour) const -> const pixel_colour_ref&
+    {
+        *d_rgba = to_rgba8(colour);
+        return *this;
+    }
+
+    auto operator*=(float scale) const -> const pixel_colour_ref&
+    {
+        return *this = from_rgba8(*d_rgba) * scale;
+    }
+};
+
+class pixel_world;
+
+// A reference to a single pixel in a pixel_world. The fields mirror those of sand::pixel so
+// call sites can treat it as one, and assigning a pixel writes every field back. The type
+// is read only since changing it also changes the occupancy, so assign a whole pixel.
+
+template <bool IsConst>
+struct basic_pixel_ref
+{
+    template <typename T>
+    using field = std::conditional_t<IsConst, const T, T>;
+
+    const pixel_type&                      type;
+    pixel_colour_ref<field<std::uint32_t>> colour;
+    field<glm::vec2>&                      velocity;
+    pixel_flags_ref<field<chunk_bitboards>> flags;
+    field<std::uint8_t>&                   power;
+
+    field<pixel_world>&                    owner;
+    std::size_t                            index;
+
+    operator pixel() const
+    {
+        return pixel{
+            .type = type,
+            .colour = colour,
+            .velocity = velocity,
+            .flags = flags.to_bitset(),
+            .power = power
+        };
+    }
+
+    auto operator=(const pixel& px) -> basic_pixel_ref& requires (!IsConst);
+
+    auto operator=(const basic_pixel_ref& other) -> basic_pixel_ref& requires (!IsConst)
+    {
+        return *this = static_cast<pixel>(other);
+    }
+};
+
+using pixel_ref = basic_pixel_ref<false>;
+using const_pixel_ref = basic_pixel_ref<true>;
+
+// The pixels of one chunk as a structure of arrays, so loops that only look at pixel types
+// don't drag colours and velocities through the cache. Indexed x + chunk_size * y in chunk
+// local coordinates, the flags are kept in the chunk's bitboards.
+struct chunk_page
+{
+    static constexpr auto size = std::size_t{config::chunk_size * config::chunk_size};
+
+    std::array<pixel_type, size>    type;
+    std::array<std::uint32_t, size> colour; // Packed RGBA8, see to_rgba8
+    std::array<glm::vec2, size>     velocity;
+    std::array<std::uint8_t, size>  power;
+};
+
+// Stores the pixels of the world a chunk at a time. Pages are allocated the first time a
+// chunk is written to, until then it reads as air, and a chunk that nothing is happening in
+// can be paged out to its encoded save block in the page file and is decoded again the next
+// time it is touched. The bitboards of every chunk stay resident, so scanning them never
+// pages in.
+//
+// Pixels are indexed by chunk and then within the chunk, so the pixels of a chunk are
+// contiguous. The page of a chunk can be faulted in from several workers at once, so each
+// chunk has a mutex for that, but paging out is only done between updates.
 class pixel_world
 {
-    std::vector<pixel> d_pixels;
-    std::size_t        d_width;
-    std::size_t        d_height;
+    // Indexed the same way as world::chunks
+    mutable std::vector<std::atomic<chunk_page*>> d_pages;     // Null when not resident
+    mutable page_file                             d_page_file; // The encoded blocks of paged out chunks
+    mutable std::vector<std::mutex>               d_page_mutexes;
+    std::vector<chunk_bitboards>                  d_boards;
+
+    // Pages that were released, kept for reuse up to a limit
+    mutable std::vector<std::unique_ptr<chunk_page>> d_free_pages;
+    mutable std::mutex                               d_free_pages_mutex;
+
+    // Bumped whenever a circuit pixel is placed, removed or moved
+    std::uint64_t d_circuit_version = 0;
+
+    std::size_t d_width;
+    std::size_t d_height;
+
+    auto chunk_index(glm::ivec2 pos) const -> std::size_t
+    {
+        assert(valid(pos));
+        return (pos.y / config::chunk_size) * (d_width / config::chunk_size) + pos.x / config::chunk_size;
+    }
+
+    static auto local_index(glm::ivec2 pos) -> std::size_t
+    {
+        return (pos.x % config::chunk_size) + config::chunk_size * (pos.y % config::chunk_size);
+    }
+
+    static auto local_position(std::size_t local) -> glm::ivec2
+    {
+        return {local % config::chunk_size, local / config::chunk_size};
+    }
+
+    // Pages in the chunk if it was paged out. Otherwise a chunk that was never written to
+    // gets a fresh page when writing, and when reading shares one of air.
+    auto fault(std::size_t chunk, bool writing) const -> chunk_page*;
+    auto allocate_page() const -> std::unique_ptr<chunk_page>;
+    auto release_page(std::unique_ptr<chunk_page> page) const -> void;
+
+    auto write_page(std::size_t chunk) -> chunk_page&
+    {
+        if (const auto page = d_pages[chunk].load(std::memory_order_acquire)) return *page;
+        return *fault(chunk, true);
+    }
 
 public:
-    pixel_world(std::size_t width, std::size_t height, const std::vector<pixel>& pixels)
-        : d_pixels{pixels}
-        , d_width{width}
-        , d_height{height}
+    pixel_world(std::size_t width, std::size_t height);
+    ~pixel_world();
+
+    pixel_world(const pixel_world&) = delete;
+    pixel_world& operator=(const pixel_world&) = delete;
+
+    auto valid(glm::ivec2 pos) const -> bool
     {
-        assert(pixels.size() == width * height);
+        return 0 <= pos.x && pos.x < d_width && 0 <= pos.y && pos.y < d_height;
     }
 
-    pixel_world(std::size_t width, std::size_t height)
-        : d_pixels{width * height, pixel::air()}
-        , d_width{width}
-        , d_height{height}
-    {}
+    // Gives a chunk that was never written to a page of its own, even if the reference is
+    // only read from. Reads that may land in such chunks go through a const pixel_world.
+    auto operator[](glm::ivec2 pos) -> pixel_ref
+    {
+        const auto chunk = chunk_index(pos);
+        const auto j = local_index(pos);
+        auto& page = write_page(chunk);
+        const auto flags = pixel_flags_ref{d_boards[chunk], pos % config::chunk_size};
+        return {page.type[j], pixel_colour_ref{page.colour[j]}, page.velocity[j], flags, page.power[j], *this, chunk * chunk_page::size + j};
+    }
+
+    auto operator[](glm::ivec2 pos) const -> const_pixel_ref
+    {
+        const auto chunk = chunk_index(pos);
+        const auto j = local_index(pos);
+        const auto& p = page(chunk);
+        const auto flags = pixel_flags_ref{d_boards[chunk], pos % config::chunk_size};
+        return {p.type[j], pixel_colour_ref{p.colour[j]}, p.velocity[j], flags, p.power[j], *this, chunk * chunk_page::size + j};
+    }
+
+    // The pixels of a chunk for bulk reads, indexed the same way as world::chunks
+    auto page(std::size_t chunk) const -> const chunk_page&
+    {
+        if (const auto page = d_pages[chunk].load(std::memory_order_acquire)) return *page;
+        return *fault(chunk, false);
+    }
+
+    auto set(std::size_t i, const pixel& px) -> void;
+    auto set_type(std::size_t i, pixel_type type) -> void;
+
+    // Writes a run of pixels starting at the given position, which must all lie in the same
+    // row of the same chunk. The bitboards are updated a word at a time.
+    auto set_row(glm::ivec2 start, std::span<const pixel> row) -> void;
+    auto swap(glm::ivec2 a, glm::ivec2 b) -> void;
+    auto fill(const pixel& px) -> void;
+
+    // Clears a flag in every pixel, or in every pixel of one chunk
+    auto reset_flag(pixel_flags flag) -> void;
+    auto reset_flag(std::size_t chunk, pixel_flags flag) -> void;
 
-    auto valid(glm::ivec2 pos) const -> bool;
-    auto operator[](glm::ivec2 pos) -> pixel&;
-    auto operator[](glm::ivec2 pos) const -> const pixel&;
+    // The flags of a pixel packed with bit i being pixel_flags value i, used when saving
+    auto packed_flags(std::size_t i) const -> std::uint8_t;
+    auto set_packed_flags(std::size_t i, std::uint8_t bits) -> void;
 
-    inline auto begin() { return d_pixels.begin(); }
-    inline auto end() { return d_pixels.end(); }
+    // The bitboards of a chunk, indexed the same way as world::chunks
+    auto bitboards(std::size_t chunk) const -> const chunk_bitboards& { return d_boards[chunk]; }
+    auto bitboards(glm::ivec2 pos) const -> const chunk_bitboards& { return d_boards[chunk_index(pos)]; }
+
+    auto circuit_version() const -> std::uint64_t { return d_circuit_version; }
 
     inline auto width() const -> std::size_t { return d_width; }
     inline auto height() const -> std::size_t { return d_height; }
 
-    auto data() const -> const std::vector<pixel>& { return d_pixels; }
+    // The pixels of a chunk in the block format of the save. Encoding a paged out chunk
+    // copies its block rather than paging it in, and a block that decodes to nothing but
+    // air doesn't keep a page. Callers are responsible for waking the chunks they load.
+    auto encode_chunk(std::size_t chunk) const -> std::vector<std::byte>;
+    auto decode_chunk(std::size_t chunk, std::span<const std::byte> block) -> bool;
+
+    // Encodes the page of a chunk and releases it, or just releases it if the chunk is all
+    // air. Not safe to call during an update.
+    auto page_out(std::size_t chunk) -> void;
+    auto page_in(std::size_t chunk) -> void { page(chunk); }
+
+    // A chunk whose block failed to page in for a write is resident with the block still stored
+    auto is_paged_out(std::size_t chunk) const -> bool
+    {
+        return !d_pages[chunk].load(std::memory_order_acquire) && d_page_file.contains(chunk);
+    }
+    auto num_resident_pages() const -> std::size_t;
+    auto num_paged_out() const -> std::size_t;
+
+    // Hashes everything stored for the pixels of a chunk except is_updated, coming out the
+    // same whether or not the chunk is paged out. A paged out chunk is decoded to a page of
+    // its own rather than paged in.
+    auto hash_chunk(std::size_t chunk) const -> std::uint64_t;
+
+    // Unpacks every pixel
+    auto to_vector() const -> std::vector<pixel>;
 };
 
+template <bool IsConst>
+auto basic_pixel_ref<IsConst>::operator=(const pixel& px) -> basic_pixel_ref& requires (!IsConst)
+{
+    owner.set(index, px);
+    return *this;
+}
+
 struct world
 {
     b2World            physics;
@@ -69,11 +581,74 @@ struct world
     glm::ivec2         spawn_point;
     player_controller  player;
 
+    // When set, every chunk reseeds the random generator from this, the tick and its
+    // index before it is updated, so runs are reproducible whatever the thread count
+    std::optional<std::uint64_t> seed;
+    std::uint64_t                tick = 0;
+    std::uint64_t                scratch_epoch = 0; // Set by a scratch_scope, zero outside of one
+
+    // How many edits have been applied in the tick given, so each gets a stream of its own
+    std::uint64_t edit_tick  = 0;
+    std::uint64_t edit_count = 0;
+
+    circuit_network circuits;
+
+    // The chunks with anything in dirty_next, and those with anything in dirty, so the
+    // update and the frontend only visit chunks with work in them
+    chunk_bitset awake;
+    chunk_bitset stepping;
+
+    // The chunks with burning pixels or pixels of always awake types. Those pixels are
+    // updated every tick without keeping the rest of their chunk stepping.
+    chunk_bitset ticking;
+
+    // The chunks that may have changed since they were last copied for saving, set by
+    // anything that wakes or redraws them. Every chunk of a new world starts unsaved.
+    chunk_bitset unsaved;
+
+    // The chunks whose bodies are enabled, which are those near a dynamic body, see
+    // update_physics
+    chunk_bitset physics_enabled;
+
+    // Changing this only affects islands built from then on, see rebuild_colliders
+    collider_mode colliders = collider_mode::convex;
+
+    // When set, liquids only spread towards somewhere to fall and every stepped chunk is
+    // levelled after the update, see level_liquids, so lakes settle and go to sleep
+    bool level_liquids = false;
+
+    // Debris is simulated by Box2D rather than as pixels until it settles
+    std::vector<debris_body> debris;
+
+    // Explosions set off during an update are queued and applied by the scheduler once
+    // it is safe to do so, since they can reach well beyond the chunk that caused them.
+    std::vector<std::pair<glm::vec2, explosion>> queued_explosions;
+    std::mutex                                   queued_explosions_mutex;
+
     world(std::size_t width, std::size_t height);
     world(const world&) = delete;
     world& operator=(const world&) = delete;
     
     auto wake_chunk_with_pixel(glm::ivec2 pixel) -> void;
+
+    // Wakes an inclusive region of pixels of one chunk in chunk local coordinates
+    auto wake_chunk(std::size_t index, glm::ivec2 min, glm::ivec2 max) -> void;
+    auto wake_all() -> void;
+
+    // Wakes an inclusive region of pixels, and their neighbours, in every chunk it covers
+    auto wake_region(glm::ivec2 min, glm::ivec2 max) -> void;
+
+    // Fills a shape with pixels from the maker, clipped to the world, calling it once per
+    // pixel. Rows are written a chunk at a time and the whole shape is woken at once, so each
+    // chunk it covers is woken once however many of its pixels were filled. A span is a
+    // single row, and a rect or circle is only woken after all of its rows are written.
+    auto fill_span(int y, int x_min, int x_max, const pixel_maker& make) -> void;
+    auto fill_rect(glm::ivec2 min, glm::ivec2 max, const pixel_maker& make) -> void;
+    auto fill_circle(glm::ivec2 centre, float radius, const pixel_maker& make) -> void;
+
+    // Marks a pixel to be drawn again without waking it. Not safe to call in parallel.
+    auto redraw_pixel(glm::ivec2 pixel) -> void;
+    auto queue_explosion(glm::vec2 pos, const explosion& info) -> void;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,419 @@
+#include "world_save.hpp"
+#include "world.hpp"
+#include "config.hpp"
+#include "thread_pool.hpp"
+#include "mapped_file.hpp"
+
+#include <cereal/archives/binary.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace sand {
+namespace {
+
+static constexpr auto chunk_pixels = std::size_t{config::chunk_size * config::chunk_size};
+
+// Everything is written in the native byte order, which is little endian on every
+// platform we build for
+struct save_header
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::int32_t  spawn_x;
+    std::int32_t  spawn_y;
+};
+
+struct chunk_entry
+{
+    std::uint64_t offset; // From the start of the file
+    std::uint64_t size;
+};
+
+template <typename T>
+auto write(std::vector<std::byte>& out, const T& value) -> void
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    const auto bytes = std::as_bytes(std::span{&value, 1});
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+// Reads values from the front of a buffer, failing rather than reading past the end
+class reader
+{
+    std::span<const std::byte> d_data;
+    bool                       d_ok = true;
+
+public:
+    explicit reader(std::span<const std::byte> data) : d_data{data} {}
+
+    template <typename T>
+    auto read() -> T
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto value = T{};
+        if (d_data.size() < sizeof(T)) {
+            d_ok = false;
+            return value;
+        }
+        std::memcpy(&value, d_data.data(), sizeof(T));
+        d_data = d_data.subspan(sizeof(T));
+        return value;
+    }
+
+    // Copies the next bytes straight into the given array
+    template <typename T, std::size_t N>
+    auto read_into(std::array<T, N>& out) -> void
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto size = sizeof(T) * N;
+        if (d_data.size() < size) {
+            d_ok = false;
+            return;
+        }
+        std::memcpy(out.data(), d_data.data(), size);
+        d_data = d_data.subspan(size);
+    }
+
+    auto ok() const -> bool { return d_ok; }
+};
+
+template <typename T, std::size_t N>
+auto write_array(std::vector<std::byte>& out, const std::array<T, N>& values) -> void
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    const auto bytes = std::as_bytes(std::span{values});
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+// The first byte of every block says how the rest of it is encoded. Most chunks are large
+// uniform areas that collapse into a few runs, but noisy ones come out smaller stored as
+// the raw fields of the page, which also decode with a single copy per field.
+enum class block_encoding : std::uint8_t
+{
+    runs,
+    raw,
+};
+
+static constexpr auto raw_block_size = 1 + sizeof(chunk_page::type) + sizeof(chunk_page::colour)
+                                     + sizeof(chunk_page::velocity) + sizeof(chunk_page::power)
+                                     + num_pixel_flags * config::chunk_size * sizeof(std::uint64_t);
+
+// Values are written in runs of a count followed by the value. A chunk never has more
+// runs than pixels, so the counts fit in 16 bits. get(i) gives the value of the ith pixel
+// of the chunk in row order.
+template <typename T>
+auto write_runs(std::vector<std::byte>& out, auto&& get) -> void
+{
+    auto i = std::size_t{0};
+    while (i != chunk_pixels) {
+        const T value = get(i);
+        auto end = i + 1;
+        while (end != chunk_pixels && get(end) == value) { ++end; }
+        write(out, static_cast<std::uint16_t>(end - i));
+        write(out, value);
+        i = end;
+    }
+}
+
+// Pages are laid out in the same row order as blocks
+auto local_position(std::size_t i) -> glm::ivec2
+{
+    return {i % config::chunk_size, i / config::chunk_size};
+}
+
+template <typename T>
+auto read_runs(reader& in, auto&& set) -> bool
+{
+    auto i = std::size_t{0};
+    while (i != chunk_pixels) {
+        const auto count = in.read<std::uint16_t>();
+        const auto value = in.read<T>();
+        if (!in.ok() || count == 0 || i + count > chunk_pixels) return false;
+        for (const auto end = i + count; i != end; ++i) {
+            if (!set(i, value)) return false;
+        }
+    }
+    return true;
+}
+
+auto decode_runs(reader& in, chunk_page& page, chunk_bitboards* boards) -> bool
+{
+    auto palette = std::vector<std::uint32_t>(in.read<std::uint16_t>());
+    for (auto& colour : palette) {
+        colour = in.read<std::uint32_t>();
+    }
+    if (!in.ok()) return false;
+
+    return read_runs<pixel_type>(in, [&](std::size_t i, pixel_type type) {
+            if (type > pixel_type::relay) return false;
+            page.type[i] = type;
+            if (boards) {
+                boards->occupied.set(local_position(i), type != pixel_type::none);
+                boards->circuit.set(local_position(i), is_circuit_pixel(type));
+                boards->awake_types.set(local_position(i), hot_properties(type).has(pixel_trait::always_awake));
+            }
+            return true;
+        })
+        && read_runs<std::uint16_t>(in, [&](std::size_t i, std::uint16_t colour) {
+            if (colour >= palette.size()) return false;
+            page.colour[i] = palette[colour];
+            return true;
+        })
+        && read_runs<glm::vec2>(in, [&](std::size_t i, glm::vec2 velocity) {
+            page.velocity[i] = velocity;
+            return true;
+        })
+        && read_runs<std::uint8_t>(in, [&](std::size_t i, std::uint8_t flags) {
+            if (!boards) return true;
+            for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+                boards->flags[flag].set(local_position(i), (flags >> flag) & 1u);
+            }
+            return true;
+        })
+        && read_runs<std::uint8_t>(in, [&](std::size_t i, std::uint8_t power) {
+            page.power[i] = power;
+            return true;
+        });
+}
+
+auto decode_raw(reader& in, chunk_page& page, chunk_bitboards* boards) -> bool
+{
+    in.read_into(page.type);
+    in.read_into(page.colour);
+    in.read_into(page.velocity);
+    in.read_into(page.power);
+    if (!in.ok()) return false;
+    if (std::ranges::any_of(page.type, [](pixel_type type) { return type > pixel_type::relay; })) return false;
+
+    auto flags = std::array<std::uint64_t, config::chunk_size>{};
+    for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+        in.read_into(flags);
+        if (boards) { boards->flags[flag].rows = flags; }
+    }
+    if (!in.ok()) return false;
+    if (!boards) return true;
+
+    for (int y = 0; y != config::chunk_size; ++y) {
+        auto occupied = std::uint64_t{0};
+        auto circuit = std::uint64_t{0};
+        auto awake = std::uint64_t{0};
+        for (int x = 0; x != config::chunk_size; ++x) {
+            const auto type = page.type[x + config::chunk_size * y];
+            const auto bit = std::uint64_t{1} << x;
+            if (type != pixel_type::none) occupied |= bit;
+            if (is_circuit_pixel(type)) circuit |= bit;
+            if (hot_properties(type).has(pixel_trait::always_awake)) awake |= bit;
+        }
+        boards->occupied.rows[y] = occupied;
+        boards->circuit.rows[y] = circuit;
+        boards->awake_types.rows[y] = awake;
+    }
+    return true;
+}
+
+auto load_legacy(const std::string& file_path) -> std::unique_ptr<world>
+{
+    auto file = std::ifstream{file_path, std::ios::binary};
+    auto archive = cereal::BinaryInputArchive{file};
+
+    auto save = world_save{};
+    archive(save);
+
+    if (save.pixels.size() != save.width * save.height) return nullptr;
+
+    auto w = std::make_unique<world>(save.width, save.height);
+    const auto pixels = std::span{save.pixels};
+    for (std::size_t y = 0; y != save.height; ++y) {
+        for (std::size_t x = 0; x < save.width; x += config::chunk_size) {
+            const auto count = std::min<std::size_t>(config::chunk_size, save.width - x);
+            w->pixels.set_row({x, y}, pixels.subspan(y * save.width + x, count));
+        }
+    }
+    w->pixels.reset_flag(is_updated); // Older saves were written with it still set
+    w->spawn_point = save.spawn_point;
+    w->player.set_position(save.spawn_point);
+    return w;
+}
+
+}
+
+auto encode_page(const chunk_page& page, const chunk_bitboards& boards) -> std::vector<std::byte>
+{
+    // Colours are swapped for indices into a palette private to the chunk, so that
+    // uniform areas such as air or a placed block of titanium collapse into single runs
+    auto palette = std::vector<std::uint32_t>{};
+    auto lookup = std::unordered_map<std::uint32_t, std::uint16_t>{};
+    auto colour_indices = std::array<std::uint16_t, chunk_pixels>{};
+    for (std::size_t i = 0; i != chunk_pixels; ++i) {
+        const auto [it, inserted] = lookup.try_emplace(page.colour[i], static_cast<std::uint16_t>(palette.size()));
+        if (inserted) { palette.push_back(page.colour[i]); }
+        colour_indices[i] = it->second;
+    }
+
+    auto out = std::vector<std::byte>{};
+    write(out, block_encoding::runs);
+    write(out, static_cast<std::uint16_t>(palette.size()));
+    for (const auto colour : palette) {
+        write(out, colour);
+    }
+
+    const auto packed_flags = [&](std::size_t i) {
+        auto bits = std::uint8_t{0};
+        for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+            if (flag == is_updated) continue;
+            bits |= static_cast<std::uint8_t>(boards.flags[flag].test(local_position(i)) << flag);
+        }
+        return bits;
+    };
+
+    write_runs<pixel_type>(out, [&](std::size_t i) { return page.type[i]; });
+    write_runs<std::uint16_t>(out, [&](std::size_t i) { return colour_indices[i]; });
+    write_runs<glm::vec2>(out, [&](std::size_t i) { return page.velocity[i]; });
+    write_runs<std::uint8_t>(out, packed_flags);
+    write_runs<std::uint8_t>(out, [&](std::size_t i) { return page.power[i]; });
+    if (out.size() <= raw_block_size) return out;
+
+    out.clear();
+    write(out, block_encoding::raw);
+    write_array(out, page.type);
+    write_array(out, page.colour);
+    write_array(out, page.velocity);
+    write_array(out, page.power);
+    for (std::size_t flag = 0; flag != num_pixel_flags; ++flag) {
+        for (int y = 0; y != config::chunk_size; ++y) {
+            write(out, flag == is_updated ? std::uint64_t{0} : boards.flags[flag].row(y));
+        }
+    }
+    return out;
+}
+
+auto decode_page(std::span<const std::byte> block, chunk_page& page, chunk_bitboards* boards) -> bool
+{
+    auto in = reader{block};
+    switch (in.read<block_encoding>()) {
+        case block_encoding::runs: return in.ok() && decode_runs(in, page, boards);
+        case block_encoding::raw: return decode_raw(in, page, boards);
+    }
+    return false;
+}
+
+auto save_world(const std::string& file_path, const world& w) -> void
+{
+    const auto out = encode_world(w);
+    auto file = std::ofstream{file_path, std::ios::binary};
+    file.write(reinterpret_cast<const char*>(out.data()), out.size());
+}
+
+auto encode_world(const world& w) -> std::vector<std::byte>
+{
+    auto blocks = std::vector<std::vector<std::byte>>(w.chunks.size());
+    for (std::size_t index = 0; index != w.chunks.size(); ++index) {
+        blocks[index] = w.pixels.encode_chunk(index);
+    }
+    return encode_save(w.pixels.width(), w.pixels.height(), w.spawn_point, blocks);
+}
+
+auto encode_save(
+    std::size_t width,
+    std::size_t height,
+    glm::ivec2 spawn_point,
+    std::span<const std::vector<std::byte>> blocks) -> std::vector<std::byte>
+{
+    auto out = std::vector<std::byte>{};
+    write(out, save_header{
+        .magic = save_magic,
+        .version = save_version,
+        .width = static_cast<std::uint32_t>(width),
+        .height = static_cast<std::uint32_t>(height),
+        .spawn_x = spawn_point.x,
+        .spawn_y = spawn_point.y
+    });
+
+    // The blocks follow straight after the table
+    auto offset = out.size() + blocks.size() * sizeof(chunk_entry);
+    for (const auto& block : blocks) {
+        write(out, chunk_entry{.offset = offset, .size = block.size()});
+        offset += block.size();
+    }
+    for (const auto& block : blocks) {
+        out.insert(out.end(), block.begin(), block.end());
+    }
+    return out;
+}
+
+auto decode_world(std::span<const std::byte> data, thread_pool& pool) -> std::unique_ptr<world>
+{
+    auto in = reader{data};
+    const auto header = in.read<save_header>();
+    if (!in.ok() || header.magic != save_magic) return nullptr;
+    if (header.version != save_version && header.version != first_chunked_version) return nullptr;
+    if (header.width == 0 || header.width % config::chunk_size != 0) return nullptr;
+    if (header.height == 0 || header.height % config::chunk_size != 0) return nullptr;
+
+    auto w = std::make_unique<world>(header.width, header.height);
+
+    auto entries = std::vector<chunk_entry>(w->chunks.size());
+    for (auto& entry : entries) {
+        entry = in.read<chunk_entry>();
+        if (entry.offset > data.size() || entry.size > data.size() - entry.offset) return nullptr;
+    }
+    if (!in.ok()) return nullptr;
+
+    auto ok = std::atomic<bool>{true};
+    pool.parallel_for(entries.size(), [&](std::size_t index) {
+        const auto block = data.subspan(entries[index].offset, entries[index].size);
+
+        // The first chunked saves only had run length encoded blocks, without the leading
+        // encoding byte
+        if (header.version == first_chunked_version) {
+            auto tagged = std::vector<std::byte>{static_cast<std::byte>(block_encoding::runs)};
+            tagged.insert(tagged.end(), block.begin(), block.end());
+            if (!w->pixels.decode_chunk(index, tagged)) {
+                ok = false;
+            }
+        }
+        else if (!w->pixels.decode_chunk(index, block)) {
+            ok = false;
+        }
+    });
+    if (!ok) return nullptr;
+
+    w->spawn_point = {header.spawn_x, header.spawn_y};
+    w->player.set_position(w->spawn_point);
+    return w;
+}
+
+auto load_world(const std::string& file_path) -> std::unique_ptr<world>
+{
+    auto pool = thread_pool{1};
+    return load_world(file_path, pool);
+}
+
+auto load_world(const std::string& file_path, thread_pool& pool) -> std::unique_ptr<world>
+{
+    // Blocks are decoded straight out of the mapping, so the file is never copied whole
+    const auto file = mapped_file{file_path};
+    if (!file.is_open()) return nullptr;
+    const auto data = file.data();
+
+    auto magic = std::uint32_t{0};
+    if (data.size() >= sizeof(magic)) {
+        std::memcpy(&magic, data.data(), sizeof(magic));
+    }
+    if (magic == save_magic) {
+        return decode_world(data, pool);
+    }
+    return load_legacy(file_path);
+}
+
+}
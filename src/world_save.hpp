@@ -3,9 +3,21 @@
 #include "pixel.hpp"
 
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
 
 namespace sand {
 
+struct world;
+struct chunk_page;
+struct chunk_bitboards;
+class thread_pool;
+
+// The original save format, a cereal archive of every pixel. Only read now, for levels
+// saved before the chunked format.
 struct world_save
 {
     std::vector<pixel> pixels;
@@ -19,4 +31,36 @@ struct world_save
     }
 };
 
-}
\ No newline at end of file
+// Saves are written in a chunked format: a header, then a table giving the offset and
+// size of every chunk's block, then the blocks. Each block either run length encodes the
+// pixel fields of one chunk, with colours stored as indices into a per-chunk palette, or
+// stores them raw when that is no bigger. Blocks are independent, so they are decoded in
+// parallel straight from the mapped file into the world.
+static constexpr auto save_magic            = std::uint32_t{0x444e4153}; // "SAND"
+static constexpr auto save_version          = std::uint32_t{3};
+static constexpr auto first_chunked_version = std::uint32_t{2}; // Still read
+
+auto save_world(const std::string& file_path, const world& w) -> void;
+
+// The same save held in memory. Decoding returns nullptr if the data is corrupt.
+auto encode_world(const world& w) -> std::vector<std::byte>;
+auto decode_world(std::span<const std::byte> data, thread_pool& pool) -> std::unique_ptr<world>;
+
+// Assembles a save from the blocks of every chunk, given in the order of world::chunks
+auto encode_save(
+    std::size_t width,
+    std::size_t height,
+    glm::ivec2 spawn_point,
+    std::span<const std::vector<std::byte>> blocks
+) -> std::vector<std::byte>;
+
+// The block of a single chunk, also used to hold the pixels of chunks that are paged out.
+// The flags are read from the chunk's bitboards, and only written back to them if given.
+auto encode_page(const chunk_page& page, const chunk_bitboards& boards) -> std::vector<std::byte>;
+auto decode_page(std::span<const std::byte> block, chunk_page& page, chunk_bitboards* boards) -> bool;
+
+// Returns nullptr if the file cannot be read or is corrupt
+auto load_world(const std::string& file_path) -> std::unique_ptr<world>;
+auto load_world(const std::string& file_path, thread_pool& pool) -> std::unique_ptr<world>;
+
+}